@@ -7,6 +7,12 @@
 
 #define BOARD_heap_number_of_blocks		0x10			//set the number of heap blocks 
 #define BOARD_heap_single_block_size	0x20			//set single heap block size in bytes
+#define BOARD_include_slab				TRUE			//set TRUE if you want to allocate small objects (8, 16, 32 bytes) from the slab
+#define BOARD_heap_owner_tracking		TRUE			//set TRUE if the heap should remember which task allocated the memory, task_erase can free it
+#define BOARD_heap_number_of_handles	0x08			//set the number of handles of relocatable memory moved by the heap compaction, 0 - no relocatable memory
+#define BOARD_heap_placement			HEAP_placement_first_fit	//set the placement of the heap allocations: HEAP_placement_first_fit, _best_fit, _next_fit or _buddy
+#define BOARD_heap_persistent_size		0x80			//set the size in bytes of the heap region in .noinit memory which survives the watchdog and brown-out reset, 0 - no persistent memory
+#define BOARD_heap_debug				FALSE			//set TRUE to guard the heap allocations with canary bytes, check the frees and report the leaks
 
 
 #define BOARD_stack_size				300				//set stack size in bytes
@@ -16,6 +22,10 @@
 #define BOARD_cpu_clock					14745600		//set the frequency of the oscillator
 #define BOARD_include_timers			TRUE			//set TRUE if you want to use timers
 #define BOARD_has_external_clock_input	FALSE			//set TRUE if you connected an external 32.768KHz oscillator
+#define BOARD_task_number_of_priorities	4				//set the number of task priority levels (1 - 8)
+#define BOARD_task_timeouts				FALSE			//set TRUE to use the condWait waits with a timeout, every task handle takes 6 bytes more
+#define BOARD_tickless_idle				FALSE			//set TRUE if the system timer should not wake up the CPU every tick while sleeping
+#define BOARD_timers_timing_wheel		FALSE			//set TRUE if you use many timers, they are kept in a hierarchical timing wheel instead of a list
 
 
 #endif
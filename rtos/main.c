@@ -14,7 +14,6 @@ void (*rtos_initialize_avr_device)(void) = INI;
 void timer_function(void)
 {
 	PORTD ^= 0xff;
-	timer_start_notify_function(&timer, 1000, timer_function);
 }
 
 
@@ -29,6 +28,7 @@ TASK_my_task_t menu_led_f(void)
 		
 		if(led == 0){
 			timer_function();
+			timer_start_periodic_notify_function(&timer, 1000, timer_function);
 			condWait_task_delay(4999);
 			timer_stop(&timer);
 		}
@@ -38,6 +38,7 @@ TASK_my_task_t menu_led_f(void)
 
 void INI()
 {	
+	timer_init(&timer);
 	task_setup(&menu_led, menu_led_f);
 	task_start(&menu_led);
 }
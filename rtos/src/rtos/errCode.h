@@ -36,6 +36,10 @@
  		#define __Err_DeviceSoftware_rtOS_DynamicMemoryBlockS	0x00040000	//Too big block
  		#define __Err_DeviceSoftware_rtOS_StackOverflowUp		0x00050000	//Stack overflow by task too many variables in task definition
  		#define __Err_DeviceSoftware_rtOS_StackOverflowDown		0x00060000	//Stack overflow by functions called from task too many variables in a functions definition or to many references to the function
+ 		#define __Err_DeviceSoftware_rtOS_HeapOverrun			0x00070000	//The canary behind the heap memory was overwritten, the low word is the code address of the owner task
+ 		#define __Err_DeviceSoftware_rtOS_HeapDoubleFree		0x00080000	//The heap memory was already free
+ 		#define __Err_DeviceSoftware_rtOS_HeapInvalidFree		0x00090000	//The address is not the start of the heap memory
+ 		#define __Err_DeviceSoftware_rtOS_HeapLeak				0x000A0000	//The heap memory is still allocated, the low word is the code address of the owner task
 
 
 	#define __Err_DeviceSoftware_				0x00800000
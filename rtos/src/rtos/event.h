@@ -51,6 +51,24 @@ void event_action_notify_listeners(event_action_t *sender);
 			condWait_semaphore_wait(sender)
 
 
+#if BOARD_task_timeouts == TRUE
+
+/**********************************************************************************************//**
+ * @fn	uint8_t condWait_event_action_wait_timeout(event_action_t *sender, uint16_t time_ms)
+ *
+ * @brief	This function will suspend the currently running task and
+ *			add it to the list of tasks waiting for some action to occur until the action occurs or the time runs out.
+ *			If the time is equal to 0, the task waits without a timeout.
+ *
+ * @param		sender			pointer to the action sender.
+ *				time_ms			timeout in ms.
+ * @returns		uint8_t			TRUE - the action has occurred, FALSE - the time ran out.
+  **************************************************************************************************/
+#define condWait_event_action_wait_timeout(sender, time_ms)\
+			condWait_semaphore_wait_timeout(sender, time_ms)
+#endif
+
+
 /**********************************************************************************************//**
  * @fn	void condWait_event_wait_signal(uint8_t volatile *sig_src, uint8_t sig_mask, uint16_t time_ms)
  *
@@ -10,186 +10,2091 @@
 
 
 #define FREE_BLOCK_MARKER	0
+#define HEAP_free_map_size	((BOARD_heap_number_of_blocks + 7) >> 3)
+#define HEAP_no_free_run	0xFF
 
 #if BOARD_heap_number_of_blocks > 255
 	#error The number of blocks can not exceed 255
 #endif
 
+#if BOARD_heap_debug == TRUE
+#define HEAP_debug_canary		0xC5
+#define HEAP_debug_no_canary	0			//the size of the allocation whose canary has been removed
+#else
+#define __heap_debug_arm(memory_addr, bytes_num)
+#endif
+
+#define HEAP_debug_blocks(bytes_num)	(((bytes_num) / BOARD_heap_single_block_size) +\
+			(((bytes_num) % BOARD_heap_single_block_size + HEAP_debug_canary_size + BOARD_heap_single_block_size - 1) / BOARD_heap_single_block_size))
+
 
 struct heap{
+	heap_region_t	region;													//the default region, the other regions are linked to it
 	uint8_t			mem_space[BOARD_heap_number_of_blocks][BOARD_heap_single_block_size];
 	uint8_t			mem_allocation_markers[BOARD_heap_number_of_blocks];
-	uint8_t			mem_free_blocks;
+	uint8_t			mem_free_map[HEAP_free_map_size];
+	uint8_t			mem_free_runs[BOARD_heap_number_of_blocks + 1];
+#if BOARD_heap_owner_tracking == TRUE
+	task_handle_t	*mem_owners[BOARD_heap_number_of_blocks];				//the task which allocated the memory, valid for the first block of the allocation
+#endif
+#if BOARD_heap_debug == TRUE
+	uint16_t		mem_sizes[BOARD_heap_number_of_blocks];					//the requested bytes, the canary follows them, valid for the first block of the allocation
+#endif
+#if BOARD_heap_number_of_handles > 0
+	struct{
+		uint8_t		block;													//the first block of the memory, HEAP_no_block if the handle is not used
+		uint8_t		locks;													//the memory is not moved while it is locked
+	}mem_handles[BOARD_heap_number_of_handles];
+#endif
+	heap_pool_t		*pools;													//the list of the pools of fixed blocks
 	semaphore_t		mem_guard;
 };
 
-RTOS_static volatile struct heap __heap;//	__attribute__((section(".noinit")));
+RTOS_static struct heap __heap;//	__attribute__((section(".noinit")));
+
+#define HEAP_default_region		(&__heap.region)
+#define HEAP_region_block(region, block_index)\
+			((region)->mem_space + (uint16_t)(block_index) * (region)->block_size)
+
+#if BOARD_heap_persistent_size > 0
+#define HEAP_persistent_magic	0x5AA5
+
+struct heap_persistent{
+	uint16_t		magic;
+	uint16_t		checksum;												//the checksum of the description of the blocks and the keys
+	heap_region_t	region;
+	struct{
+		char		name[HEAP_persistent_name_size];
+		uint8_t		block;													//the first block of the memory, HEAP_no_block if the key is not used
+	}keys[HEAP_persistent_number_of_keys];
+	uint8_t			memory[BOARD_heap_persistent_size];
+};
+
+extern volatile uint8_t MCUCSR_saved_val;
+RTOS_static struct heap_persistent __heap_persistent	__attribute__((section(".noinit")));
+#endif
 
 
+#if BOARD_heap_debug == TRUE
 /**********************************************************************************************//**
- * @fn	void __heap_wake_up_next_waiting_task(void)
+ * @fn	static void __heap_debug_arm(void *memory_addr, uint16_t bytes_num)
  *
- * @brief	the function checks if there is any task waiting for free dynamic memory, if so, the next waiting task will be woken up
+ * @brief	the function remembers the requested size of the memory of the default heap and writes the canary behind it
  *
+ * @param		memory_addr		memory address, the first block of the allocation.
+ * @param		bytes_num   	number of the requested bytes.
  **************************************************************************************************/
 
-static void __heap_wake_up_next_waiting_task(void)
+static void __heap_debug_arm(void *memory_addr, uint16_t bytes_num)
 {
-	semaphore_signal((semaphore_t *)&__heap.mem_guard);
-	semaphore_wait((semaphore_t *)&__heap.mem_guard);
+	__heap.mem_sizes[__heap_get_block_index(memory_addr)] = bytes_num;
+	memset((uint8_t *)memory_addr + bytes_num, HEAP_debug_canary, HEAP_debug_canary_size);
 }
 
 
 /**********************************************************************************************//**
- * @fn	uint8_t heap_check_if_dynamic_mem(void *mem_addr)
+ * @fn	void __heap_debug_disarm(void *memory_addr)
  *
- * @brief	the function checks whether the given memory address comes from the heap address range
+ * @brief	Used by the system for the memory whose bytes behind the requested size are used, e.g. by the dynamic variables
+ *			of the task handle created by task_new. The canary is cleared and the memory is no longer checked.
  *
- * @param 	mem_addr   	memory address.
- * @returns	TRUE - if in the heap range, FALSE - if outside the heap range.
+ * @param		memory_addr		memory address, the first block of the allocation.
  **************************************************************************************************/
 
-uint8_t heap_check_if_dynamic_mem(void *mem_addr)
+void __heap_debug_disarm(void *memory_addr)
 {
-	if( (mem_addr >= (void *)__heap.mem_space[0x00]) &&
-		(mem_addr <= (void *)__heap.mem_space[(BOARD_heap_number_of_blocks - 0x01)])
-	){
-		return TRUE;
+	uint8_t block_index = __heap_get_block_index(memory_addr);
+	
+	if( (block_index == HEAP_no_block) || (__heap.mem_sizes[block_index] == HEAP_debug_no_canary) )return;
+	
+	memset((uint8_t *)memory_addr + __heap.mem_sizes[block_index], 0x00, HEAP_debug_canary_size);
+	__heap.mem_sizes[block_index] = HEAP_debug_no_canary;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static uint8_t __heap_debug_check_canary(uint8_t block_index)
+ *
+ * @brief	the function checks the canary behind the allocation starting at the given block, the broken canary is written again,
+ *			so the overrun is reported only once. It has to be called with the interrupts disabled.
+ *
+ * @param		block_index		index of the first block of the allocation.
+ *
+ * @returns	TRUE - the canary is intact, FALSE - the memory has been overrun.
+ **************************************************************************************************/
+
+static uint8_t __heap_debug_check_canary(uint8_t block_index)
+{
+	uint8_t *canary = HEAP_region_block(HEAP_default_region, block_index) + __heap.mem_sizes[block_index];
+	
+	if(__heap.mem_sizes[block_index] == HEAP_debug_no_canary)return TRUE;
+	
+	for(uint8_t i = 0; i < HEAP_debug_canary_size; i++){
+		if(canary[i] != HEAP_debug_canary){
+			memset(canary, HEAP_debug_canary, HEAP_debug_canary_size);
+			return FALSE;
+		}
 	}
-	return FALSE;
+	return TRUE;
 }
 
 
 /**********************************************************************************************//**
- * @fn	void heap_init(void)
+ * @fn	static uint32_t __heap_debug_error_code(uint32_t err_code, uint8_t block_index)
  *
- * @brief	the function initialize the heap memory
+ * @brief	the function adds the code address of the owner task of the allocation to the error code
  *
+ * @param		err_code		error code.
+ * @param		block_index		index of the first block of the allocation.
+ *
+ * @returns	uint32_t  error code with the code address of the owner task or, if the owner is unknown, with the number of the first block + 1.
  **************************************************************************************************/
 
-void heap_init(void)
+static uint32_t __heap_debug_error_code(uint32_t err_code, uint8_t block_index)
 {
-	__heap.mem_free_blocks = BOARD_heap_number_of_blocks;
-	memset((uint8_t *)__heap.mem_allocation_markers, FREE_BLOCK_MARKER, BOARD_heap_number_of_blocks);
-	semaphore_init((semaphore_t *)&__heap.mem_guard, 1, 0);
+#if BOARD_heap_owner_tracking == TRUE
+	if(__heap.mem_owners[block_index] != NULL){
+		return err_code | task_get_function_address(__heap.mem_owners[block_index]);
+	}
+#endif
+	return err_code | (uint16_t)(block_index + 1);
 }
+#endif
 
 
 /**********************************************************************************************//**
- * @fn	uint16_t heap_get_size_of_free_memory(void)
+ * @fn	static void __heap_set_free_map(heap_region_t *region, uint8_t block_index, uint8_t blocks_num, uint8_t free)
  *
- * @brief	the function returns the size of free space on the heap
+ * @brief	the function marks the blocks as free or occupied in the map of free blocks,
+ *			the whole bytes of the map are written at once
  *
- * @returns	uint16_t.
+ * @param		region			pointer to the heap region.
+ * @param		block_index		index of the first block.
+ * @param		blocks_num		number of blocks.
+ * @param		free			TRUE - the blocks are free, FALSE - the blocks are occupied.
  **************************************************************************************************/
 
-uint16_t heap_get_size_of_free_memory(void)
+static void __heap_set_free_map(heap_region_t *region, uint8_t block_index, uint8_t blocks_num, uint8_t free)
 {
-	return ((uint16_t)__heap.mem_free_blocks * (uint16_t)BOARD_heap_single_block_size);
+	while(blocks_num){
+		uint8_t *map = &region->mem_free_map[block_index >> 3];
+		uint8_t mask;
+		
+		if( ((block_index & 0x07) == 0) && (blocks_num >= 8) ){
+			mask		= 0xFF;
+			block_index	+= 8;
+			blocks_num	-= 8;
+			
+		}else{
+			mask = _BV(block_index & 0x07);
+			block_index++;
+			blocks_num--;
+		}
+		*map = (free == TRUE) ? (*map | mask) : (*map & ~mask);
+	}
 }
 
 
 /**********************************************************************************************//**
- * @fn	void * heap_malloc(uint16_t bytes_num)
+ * @fn	static uint8_t __heap_find_first_fit(heap_region_t *region, uint8_t blocks_num, uint8_t byte_index)
  *
- * @brief	the function allocates the requested amount of space in the heap memory.
- *			the function returns the address of available memory or, if it is missing, 
- *			it returns null.
+ * @brief	the function looks for the first run of free blocks long enough, starting from the given byte of the map.
+ *			the bytes of the map with all blocks free or all blocks occupied are skipped at once
  *
- * @param		bytes_num   number of bytes.
- * @returns	void *  memory address or NULL.
+ * @param		region			pointer to the heap region.
+ * @param		blocks_num		number of blocks.
+ * @param		byte_index		the first byte of the map to check, the block index divided by 8.
+ *
+ * @returns	uint8_t  index of the first block of the run or HEAP_no_free_run.
  **************************************************************************************************/
 
-void * heap_malloc(uint16_t bytes_num)
+static uint8_t __heap_find_first_fit(heap_region_t *region, uint8_t blocks_num, uint8_t byte_index)
 {
-	uint8_t blocks_num, irq_flag, tot_free_block;
+	uint8_t run = 0, run_start = 0;
+	uint8_t map_size = (region->blocks_num + 7) >> 3;
 	
-	if(bytes_num == 0)return NULL;
-	
-	blocks_num		= (bytes_num + BOARD_heap_single_block_size - 0x01)/BOARD_heap_single_block_size;
-	irq_flag		= rtos_cli();
-	tot_free_block	= __heap.mem_free_blocks;
-	
-	for(uint8_t free_block_cnt=0x00, block_index=0x00; 
-		(block_index < BOARD_heap_number_of_blocks) && (tot_free_block >= blocks_num); 
-		block_index++)
-	{
-		if(__heap.mem_allocation_markers[block_index] == FREE_BLOCK_MARKER){
-			if(++free_block_cnt == blocks_num){
-				uint8_t occupied_block_marker;
-					
-				block_index				-= (blocks_num - 1);
-				occupied_block_marker	= block_index + 1;
-				__heap.mem_free_blocks	-= blocks_num;
-					
-				memset((uint8_t *)&__heap.mem_allocation_markers[block_index], occupied_block_marker, blocks_num);
-				rtos_sei(irq_flag);
-				memset((uint8_t *)__heap.mem_space[block_index], 0x00, (BOARD_heap_single_block_size * blocks_num));
-				return 	(void *)__heap.mem_space[block_index];
+	for(; byte_index < map_size; byte_index++){
+		uint8_t map			= region->mem_free_map[byte_index];
+		uint8_t block_index	= byte_index << 3;
+		
+		if(map == 0x00){
+			run = 0;
+		
+		}else if(map == 0xFF){
+			if(run == 0)run_start = block_index;
+			if((blocks_num - run) <= 8)return run_start;
+			run += 8;
+		
+		}else{
+			for(uint8_t bit = 0; bit < 8; bit++, map >>= 1){
+				if(map & 0x01){
+					if(run == 0)run_start = block_index + bit;
+					if(++run == blocks_num)return run_start;
+				
+				}else{
+					run = 0;
+				}
 			}
+		}
+	}
+	return HEAP_no_free_run;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static uint8_t __heap_count_free_run(heap_region_t *region, uint8_t block_index, int8_t step)
+ *
+ * @brief	the function counts the free blocks next to each other, starting from the given block
+ *
+ * @param		region			pointer to the heap region.
+ * @param		block_index		index of the first block to check.
+ * @param		step			1 - counts up, -1 - counts down.
+ *
+ * @returns	uint8_t  number of free blocks.
+ **************************************************************************************************/
 
+static uint8_t __heap_count_free_run(heap_region_t *region, uint8_t block_index, int8_t step)
+{
+	uint8_t run = 0;
+	
+	while(block_index < region->blocks_num){	//the index wraps to 255 below the block 0
+		uint8_t map = region->mem_free_map[block_index >> 3];
+		
+		if( (map == 0xFF) && ((block_index & 0x07) == ((step > 0) ? 0x00 : 0x07)) ){
+			run			+= 8;
+			block_index	+= 8 * step;
+		
+		}else if(map & _BV(block_index & 0x07)){
+			run++;
+			block_index += step;
+		
 		}else{
-			tot_free_block -= free_block_cnt;
-			free_block_cnt = 0x00;
+			break;
 		}
 	}
+	return run;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static uint16_t __heap_placement_blocks(heap_region_t *region, uint16_t blocks_num)
+ *
+ * @brief	the function returns the number of blocks taken for the request by the placement policy,
+ *			the buddy placement rounds the request up to a power of two if the region is large enough
+ *
+ * @param		region			pointer to the heap region.
+ * @param		blocks_num		number of requested blocks.
+ *
+ * @returns	uint16_t  number of blocks to take.
+ **************************************************************************************************/
+
+static uint16_t __heap_placement_blocks(heap_region_t *region, uint16_t blocks_num)
+{
+#if BOARD_heap_placement == HEAP_placement_buddy
+	uint16_t buddy_size = 1;
 	
-	rtos_sei(irq_flag);
-	rtos_error(0x01, __Err_DeviceSoftware_rtOS_DynamicMemory);
+	while(buddy_size < blocks_num){
+		buddy_size <<= 1;
+	}
+	if(buddy_size <= region->blocks_num){
+		return buddy_size;
+	}
+#endif
+	return blocks_num;
+}
 
-	return NULL;
+
+/**********************************************************************************************//**
+ * @fn	static uint8_t __heap_placement_align(uint8_t block_index, uint8_t blocks_num)
+ *
+ * @brief	the function returns the first block from the given one where the memory can be placed by the placement policy,
+ *			the buddy placement puts the memory of a power of two blocks at a multiple of its size
+ *
+ * @param		block_index		index of the block.
+ * @param		blocks_num		number of blocks of the memory.
+ *
+ * @returns	uint8_t  index of the first block where the memory can start, it may be past the heap.
+ **************************************************************************************************/
+
+static uint8_t __heap_placement_align(uint8_t block_index, uint8_t blocks_num)
+{
+#if BOARD_heap_placement == HEAP_placement_buddy
+	if( (blocks_num != 0) && ((blocks_num & (blocks_num - 1)) == 0) ){
+		uint16_t aligned_index = ((uint16_t)block_index + blocks_num - 1) & ~((uint16_t)blocks_num - 1);
+		
+		return (aligned_index > 0xFF) ? 0xFF : (uint8_t)aligned_index;
+	}
+#endif
+	return block_index;
 }
 
 
 /**********************************************************************************************//**
- * @fn	void * __heap_malloc(uint16_t bytes_num)
+ * @fn	static uint8_t __heap_find_free_run(heap_region_t *region, uint8_t blocks_num)
  *
- * @brief	the function allocates the requested amount of space in the heap memory.
- *			the function returns the address of available memory or, if it is missing, 
- *			it will add the task to the waiting queue.
+ * @brief	the function looks for a run of free blocks long enough according to BOARD_heap_placement:
+ *			first fit - the first run from the block 0,
+ *			best fit - the shortest run, the search ends at the run of the exact length,
+ *			next fit - the first run from the end of the previous allocation, the search wraps to the block 0,
+ *			buddy - the first run starting at a multiple of the number of blocks, if it is a power of two.
  *
- * @param		bytes_num   	number of bytes.
+ * @param		region			pointer to the heap region.
+ * @param		blocks_num		number of blocks.
  *
- * @returns	void *  memory address.
+ * @returns	uint8_t  index of the first block of the run or HEAP_no_free_run.
  **************************************************************************************************/
 
-void * __heap_malloc(uint16_t bytes_num)
+static uint8_t __heap_find_free_run(heap_region_t *region, uint8_t blocks_num)
 {
-	void *ptr_mem = heap_malloc(bytes_num);
+#if BOARD_heap_placement == HEAP_placement_best_fit
+	uint8_t best_index	= HEAP_no_free_run;
+	uint8_t best_run	= 0;
+	uint16_t block_index = 0;
 	
-	if(ptr_mem == NULL){
-		__semaphore_wait((semaphore_t *)&__heap.mem_guard);
+	while(block_index < region->blocks_num){
+		uint8_t run;
+		
+		if( ((block_index & 0x07) == 0) && (region->mem_free_map[block_index >> 3] == 0x00) ){
+			block_index += 8;			//all blocks of the byte are occupied
+			continue;
+		}
+		run = __heap_count_free_run(region, block_index, 1);
+		
+		if(run == 0){
+			block_index++;
+			continue;
+		}
+		if( (run >= blocks_num) && ((best_index == HEAP_no_free_run) || (run < best_run)) ){
+			best_index	= block_index;
+			best_run	= run;
+			
+			if(run == blocks_num)break;
+		}
+		block_index += run;
 	}
-	return ptr_mem;
+	return best_index;
+	
+#elif BOARD_heap_placement == HEAP_placement_next_fit
+	uint8_t block_index = __heap_find_first_fit(region, blocks_num, region->mem_next_fit);
+	
+	if( (block_index == HEAP_no_free_run) && (region->mem_next_fit != 0) ){
+		block_index = __heap_find_first_fit(region, blocks_num, 0);
+	}
+	if(block_index != HEAP_no_free_run){
+		region->mem_next_fit = (uint8_t)(((uint16_t)block_index + blocks_num) >> 3);
+	}
+	return block_index;
+	
+#elif BOARD_heap_placement == HEAP_placement_buddy
+	if(blocks_num & (blocks_num - 1)){
+		return __heap_find_first_fit(region, blocks_num, 0);		//the request has not been rounded, the region is too small
+	}
+	for(uint16_t block_index = 0; (block_index + blocks_num) <= region->blocks_num; block_index += blocks_num){
+		if(__heap_count_free_run(region, block_index, 1) >= blocks_num){
+			return block_index;
+		}
+	}
+	return HEAP_no_free_run;
+	
+#else
+	return __heap_find_first_fit(region, blocks_num, 0);
+#endif
 }
 
 
 /**********************************************************************************************//**
- * @fn	void heap_free(void *memory_addr)
+ * @fn	static void __heap_take_free_blocks(heap_region_t *region, uint8_t block_index, uint8_t blocks_num)
  *
- * @brief	the function frees space in the heap memory.
+ * @brief	the function marks the free blocks as occupied and updates the statistics of the runs of free blocks,
+ *			the blocks have to be a part of one run of free blocks. the interrupts have to be disabled
  *
- * @param		memory_addr   	memory address to free.
+ * @param		region			pointer to the heap region.
+ * @param		block_index		index of the first block.
+ * @param		blocks_num		number of blocks.
  **************************************************************************************************/
 
-void heap_free(void *memory_addr)
+static void __heap_take_free_blocks(heap_region_t *region, uint8_t block_index, uint8_t blocks_num)
 {
-	if(heap_check_if_dynamic_mem(memory_addr) == TRUE)
-	{	
-		uint8_t block_index, occupied_block_marker;
-		uint8_t irq_flag;
+	uint8_t left_run, right_run, run;
+	
+	__heap_set_free_map(region, block_index, blocks_num, FALSE);
+	left_run	= __heap_count_free_run(region, block_index - 1, -1);
+	right_run	= __heap_count_free_run(region, block_index + blocks_num, 1);
+	run			= left_run + blocks_num + right_run;		//the run the blocks have been taken from
+	
+	region->mem_free_runs[run]--;
+	if(left_run)region->mem_free_runs[left_run]++;
+	if(right_run)region->mem_free_runs[right_run]++;
+	
+	if( (run == region->mem_largest_free_run) && (region->mem_free_runs[run] == 0) ){
+		while( (region->mem_largest_free_run != 0) && (region->mem_free_runs[region->mem_largest_free_run] == 0) ){
+			region->mem_largest_free_run--;
+		}
+	}
+	region->mem_free_blocks -= blocks_num;
+	
+	if(region->mem_free_blocks < region->mem_min_free_blocks){
+		region->mem_min_free_blocks = region->mem_free_blocks;
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __heap_take_blocks(heap_region_t *region, uint8_t block_index, uint8_t blocks_num, task_handle_t *owner)
+ *
+ * @brief	the function marks the run of free blocks as allocated, the interrupts have to be disabled
+ *
+ * @param		region			pointer to the heap region.
+ * @param		block_index		index of the first block.
+ * @param		blocks_num		number of blocks.
+ * @param		owner			the task the memory is allocated for, it is remembered only in the default region.
+ **************************************************************************************************/
+
+static void __heap_take_blocks(heap_region_t *region, uint8_t block_index, uint8_t blocks_num, task_handle_t *owner)
+{
+	__heap_take_free_blocks(region, block_index, blocks_num);
+	memset(&region->mem_allocation_markers[block_index], block_index + 1, blocks_num);
+#if BOARD_heap_owner_tracking == TRUE
+	if(region == HEAP_default_region){
+		__heap.mem_owners[block_index] = owner;
+	}
+#endif
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __heap_hand_off(void)
+ *
+ * @brief	the function walks the queue of tasks waiting for memory in order of arrival and wakes up only those
+ *			whose request fits in the free blocks now. The memory is allocated for the task before it is woken up,
+ *			so no other task can take it, the task receives it when it calls the allocation again.
+ *			the interrupts have to be disabled
+ *
+ **************************************************************************************************/
 
-		block_index				= (uint8_t)(((uint16_t)memory_addr - (uint16_t)__heap.mem_space[0x00]) / (uint16_t)BOARD_heap_single_block_size);
-		occupied_block_marker	= block_index + 1;
+static void __heap_hand_off(void)
+{
+	task_handle_t *task = __heap.mem_guard.head_pending_tasks_list;
+	
+	while( (task != NULL) && (__heap.region.mem_largest_free_run != 0) ){
+		task_handle_t *next_task = task->next_task;		//the link is cleared when the task leaves the queue
 		
-		irq_flag = rtos_cli();
+		if(task->heap_request <= __heap.region.mem_largest_free_run){
+			uint8_t block_index = __heap_find_free_run(HEAP_default_region, task->heap_request);
+			
+			if(block_index != HEAP_no_free_run){
+				__heap_take_blocks(HEAP_default_region, block_index, task->heap_request, task);
+				__heap_debug_arm(HEAP_region_block(HEAP_default_region, block_index),
+								(uint16_t)task->heap_request * BOARD_heap_single_block_size - HEAP_debug_canary_size);	//until the task takes the memory
+				task_queue_remove_by_item((task_handle_t **)&__heap.mem_guard.head_pending_tasks_list, task);
+				task_set_wait_for_semaphore(NULL, task);
+				task->heap_request	= TASK_heap_request_granted;
+				task->heap_block	= block_index;
+				task_unfreeze(task);
+			}
+		}
+		task = next_task;
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __heap_release_blocks(heap_region_t *region, uint8_t block_index, uint8_t blocks_num)
+ *
+ * @brief	the function marks the run of allocated blocks as free, the interrupts have to be disabled.
+ *			__heap_hand_off() has to be called after the blocks of the default region are released
+ *
+ * @param		region			pointer to the heap region.
+ * @param		block_index		index of the first block.
+ * @param		blocks_num		number of blocks.
+ **************************************************************************************************/
+
+static void __heap_release_blocks(heap_region_t *region, uint8_t block_index, uint8_t blocks_num)
+{
+	uint8_t left_run	= __heap_count_free_run(region, block_index - 1, -1);
+	uint8_t right_run	= __heap_count_free_run(region, block_index + blocks_num, 1);
+	uint8_t run			= left_run + blocks_num + right_run;		//the freed blocks join the free neighbours
+	
+	memset(&region->mem_allocation_markers[block_index], FREE_BLOCK_MARKER, blocks_num);
+#if BOARD_heap_owner_tracking == TRUE
+	if(region == HEAP_default_region){
+		__heap.mem_owners[block_index] = NULL;
+	}
+#endif
+	region->mem_free_blocks += blocks_num;
+	__heap_set_free_map(region, block_index, blocks_num, TRUE);
+	
+	if(left_run)region->mem_free_runs[left_run]--;
+	if(right_run)region->mem_free_runs[right_run]--;
+	region->mem_free_runs[run]++;
+	
+	if(run > region->mem_largest_free_run){
+		region->mem_largest_free_run = run;
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static uint8_t __heap_count_allocated_blocks(heap_region_t *region, uint8_t block_index)
+ *
+ * @brief	the function counts the blocks of the allocation starting at the given block
+ *
+ * @param		region			pointer to the heap region.
+ * @param		block_index		index of the first block of the allocation.
+ *
+ * @returns	uint8_t  number of blocks, 0 if no allocation starts at the block.
+ **************************************************************************************************/
+
+static uint8_t __heap_count_allocated_blocks(heap_region_t *region, uint8_t block_index)
+{
+	uint8_t occupied_block_marker = block_index + 1;
+	uint8_t blocks_num = 0;
+	
+	while( (block_index < region->blocks_num) && (region->mem_allocation_markers[block_index++] == occupied_block_marker) ){
+		blocks_num++;
+	}
+	return blocks_num;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static uint8_t __heap_region_contains(heap_region_t *region, void *mem_addr)
+ *
+ * @brief	the function checks whether the given memory address belongs to the blocks of the region
+ *
+ * @param		region			pointer to the heap region.
+ * @param 		mem_addr   		memory address.
+ *
+ * @returns	TRUE - if in the region, FALSE - if outside the region.
+ **************************************************************************************************/
+
+static uint8_t __heap_region_contains(heap_region_t *region, void *mem_addr)
+{
+	if( ((uint8_t *)mem_addr >= region->mem_space) &&
+		((uint8_t *)mem_addr < HEAP_region_block(region, region->blocks_num))
+	){
+		return TRUE;
+	}
+	return FALSE;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static heap_region_t * __heap_find_region(void *mem_addr)
+ *
+ * @brief	the function looks for the region the given memory address belongs to, the default region is checked first
+ *
+ * @param 		mem_addr   		memory address.
+ *
+ * @returns	heap_region_t *  pointer to the region or NULL if the address is outside all regions.
+ **************************************************************************************************/
+
+static heap_region_t * __heap_find_region(void *mem_addr)
+{
+	heap_region_t *region = HEAP_default_region;
+	
+	while( (region != NULL) && (__heap_region_contains(region, mem_addr) == FALSE) ){
+		region = region->next_region;
+	}
+	return region;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __heap_region_reset(heap_region_t *region)
+ *
+ * @brief	the function marks all blocks of the region as free and clears its statistics,
+ *			the memory of the region and its number of blocks have to be set before
+ *
+ * @param		region			pointer to the heap region.
+ **************************************************************************************************/
+
+static void __heap_region_reset(heap_region_t *region)
+{
+	region->mem_free_blocks			= region->blocks_num;
+	region->mem_largest_free_run	= region->blocks_num;
+	region->mem_min_free_blocks		= region->blocks_num;
+	region->mem_failed_allocations	= 0;
+	region->mem_waits				= 0;
+#if BOARD_heap_placement == HEAP_placement_next_fit
+	region->mem_next_fit			= 0;
+#endif
+	memset(region->mem_free_runs, 0x00, region->blocks_num + 1);
+	region->mem_free_runs[region->blocks_num] = 1;
+	memset(region->mem_allocation_markers, FREE_BLOCK_MARKER, region->blocks_num);
+	memset(region->mem_free_map, 0x00, (region->blocks_num + 7) >> 3);
+	__heap_set_free_map(region, 0, region->blocks_num, TRUE);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void * __heap_region_alloc(heap_region_t *region, uint16_t bytes_num)
+ *
+ * @brief	the function allocates the first run of free blocks of the region long enough for the requested amount of space,
+ *			the memory is not cleared
+ *
+ * @param		region			pointer to the heap region.
+ * @param		bytes_num   	number of bytes.
+ *
+ * @returns	void *  memory address or NULL.
+ **************************************************************************************************/
+
+static void * __heap_region_alloc(heap_region_t *region, uint16_t bytes_num)
+{
+	uint16_t blocks_num;
+	uint8_t irq_flag;
+	
+	if(bytes_num == 0)return NULL;
+	
+	blocks_num		= (bytes_num / region->block_size) + ((bytes_num % region->block_size) ? 1 : 0);
+	blocks_num		= __heap_placement_blocks(region, blocks_num);
+	irq_flag		= rtos_cli();
+	
+	if(blocks_num <= region->mem_largest_free_run){
+		uint8_t block_index = __heap_find_free_run(region, blocks_num);
 		
-		for(; (block_index < BOARD_heap_number_of_blocks) && (__heap.mem_allocation_markers[block_index] == occupied_block_marker); block_index++)
-		{
-			__heap.mem_allocation_markers[block_index] = FREE_BLOCK_MARKER;
-			__heap.mem_free_blocks++;
-			__heap_wake_up_next_waiting_task();
+		if(block_index != HEAP_no_free_run){
+			__heap_take_blocks(region, block_index, blocks_num, task_this());
+			rtos_sei(irq_flag);
+			return (void *)HEAP_region_block(region, block_index);
 		}
-		rtos_sei(irq_flag);
 	}
-}
\ No newline at end of file
+	region->mem_failed_allocations++;
+	rtos_sei(irq_flag);
+	rtos_error(0x01, __Err_DeviceSoftware_rtOS_DynamicMemory);
+
+	return NULL;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static heap_pool_t * __heap_find_pool(void *mem_addr)
+ *
+ * @brief	the function looks for the pool the given memory address belongs to
+ *
+ * @param 		mem_addr   		memory address.
+ *
+ * @returns	heap_pool_t *  pointer to the pool or NULL if the address is outside all pools.
+ **************************************************************************************************/
+
+static heap_pool_t * __heap_find_pool(void *mem_addr)
+{
+	heap_pool_t *pool = __heap.pools;
+	
+	while( (pool != NULL) && (((uint8_t *)mem_addr < pool->mem_space) || ((uint8_t *)mem_addr >= pool->mem_end)) ){
+		pool = pool->next_pool;
+	}
+	return pool;
+}
+
+
+#if BOARD_heap_persistent_size > 0
+/**********************************************************************************************//**
+ * @fn	static uint16_t __heap_persistent_checksum(void)
+ *
+ * @brief	the function calculates the Fletcher checksum of the persistent region description (without the link to the next region),
+ *			the markers of the blocks, the map of free blocks and the keys. The content of the memory is not checked
+ *
+ * @returns	uint16_t  checksum.
+ **************************************************************************************************/
+
+static uint16_t __heap_persistent_checksum(void)
+{
+	heap_region_t *region	= &__heap_persistent.region;
+	uint8_t sum_low			= 0;
+	uint8_t sum_high		= 0;
+	const uint8_t *ranges[3][2] = {
+		{(const uint8_t *)region, (const uint8_t *)&region->next_region},
+		{region->mem_allocation_markers, region->mem_free_map + ((region->blocks_num + 7) >> 3)},
+		{(const uint8_t *)__heap_persistent.keys, (const uint8_t *)__heap_persistent.keys + sizeof(__heap_persistent.keys)}
+	};
+	
+	for(uint8_t range = 0; range < 3; range++){
+		for(const uint8_t *byte = ranges[range][0]; byte < ranges[range][1]; byte++){
+			sum_low		+= *byte;
+			sum_high	+= sum_low;
+		}
+	}
+	return ((uint16_t)sum_high << 8) | sum_low;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __heap_persistent_forget(uint8_t block_index)
+ *
+ * @brief	the function releases the key of the freed persistent memory and updates the checksum,
+ *			the interrupts have to be disabled
+ *
+ * @param		block_index		index of the first block of the freed memory.
+ **************************************************************************************************/
+
+static void __heap_persistent_forget(uint8_t block_index)
+{
+	for(uint8_t key = 0; key < HEAP_persistent_number_of_keys; key++){
+		if(__heap_persistent.keys[key].block == block_index){
+			__heap_persistent.keys[key].block = HEAP_no_block;
+		}
+	}
+	__heap_persistent.checksum = __heap_persistent_checksum();
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __heap_persistent_attach(void)
+ *
+ * @brief	the function links the persistent region to the heap. After a watchdog or brown-out reset the region is kept
+ *			if its checksum is correct, otherwise (power on, other resets, damaged description) it is created empty.
+ *
+ **************************************************************************************************/
+
+static void __heap_persistent_attach(void)
+{
+	heap_region_t *region = &__heap_persistent.region;
+	
+	if( (MCUCSR_saved_val & (_BV(WDRF) | _BV(BORF))) &&
+		(__heap_persistent.magic == HEAP_persistent_magic) &&
+		(region->mem_space == __heap_persistent.memory) &&
+		(region->block_size == BOARD_heap_single_block_size) &&
+		(__heap_persistent.checksum == __heap_persistent_checksum()) )
+	{
+		region->next_region			= __heap.region.next_region;
+		__heap.region.next_region	= region;
+		return;
+	}
+	heap_region_init(region, __heap_persistent.memory, BOARD_heap_persistent_size, BOARD_heap_single_block_size);
+	
+	for(uint8_t key = 0; key < HEAP_persistent_number_of_keys; key++){
+		memset(__heap_persistent.keys[key].name, 0x00, HEAP_persistent_name_size);
+		__heap_persistent.keys[key].block = HEAP_no_block;
+	}
+	__heap_persistent.magic		= HEAP_persistent_magic;
+	__heap_persistent.checksum	= __heap_persistent_checksum();
+}
+#endif
+
+
+#if BOARD_heap_number_of_handles > 0
+/**********************************************************************************************//**
+ * @fn	static heap_handle_t __heap_find_handle(uint8_t block_index)
+ *
+ * @brief	the function looks for the handle of the relocatable memory starting at the given block
+ *
+ * @param		block_index		index of the first block of the allocation.
+ *
+ * @returns	heap_handle_t  handle or HEAP_no_handle if the memory is not relocatable.
+ **************************************************************************************************/
+
+static heap_handle_t __heap_find_handle(uint8_t block_index)
+{
+	for(heap_handle_t handle = 0; handle < BOARD_heap_number_of_handles; handle++){
+		if(__heap.mem_handles[handle].block == block_index){
+			return handle;
+		}
+	}
+	return HEAP_no_handle;
+}
+#endif
+
+
+/**********************************************************************************************//**
+ * @fn	static void * __heap_wait(uint16_t bytes_num, uint8_t clear, uint16_t time_ms)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory for the currently running task.
+ *			If the memory is missing, the task is added to the waiting queue together with the number of requested blocks.
+ *			If the memory has been handed over to the task while it was waiting, it is returned without searching the heap.
+ *
+ * @param		bytes_num   	number of bytes.
+ * @param		clear			TRUE - the allocated blocks are cleared.
+ * @param		time_ms			timeout in ms, 0 - the task waits without a timeout.
+ *
+ * @returns	void *  memory address or NULL if the request can never be satisfied or the time ran out.
+ **************************************************************************************************/
+
+static void * __heap_wait(uint16_t bytes_num, uint8_t clear, uint16_t time_ms)
+{
+	task_handle_t *task = task_this();
+	uint16_t blocks_num	= HEAP_debug_blocks(bytes_num);
+	void *ptr_mem;
+	
+	if( (task != NULL) && (task->heap_request == TASK_heap_request_granted) ){
+		task->heap_request	= TASK_heap_request_none;
+		ptr_mem				= (void *)__heap.mem_space[task->heap_block];
+		
+		if(clear == TRUE){
+			memset(ptr_mem, 0x00, (BOARD_heap_single_block_size * blocks_num));
+		}
+		__heap_debug_arm(ptr_mem, bytes_num);
+		return ptr_mem;
+	}
+	if( (task != NULL) && (task->heap_request != TASK_heap_request_none) && (__task_timeout_expired() == TRUE) ){
+		task->heap_request = TASK_heap_request_none;		//the time ran out before the memory was handed over
+		return NULL;
+	}
+	ptr_mem = (clear == TRUE) ? heap_calloc(bytes_num) : heap_malloc_raw(bytes_num);
+	
+	if( (ptr_mem == NULL) && (task != NULL) && (blocks_num != 0) &&
+		(blocks_num <= BOARD_heap_number_of_blocks) && (blocks_num < TASK_heap_request_granted) )
+	{
+		task->heap_request = __heap_placement_blocks(HEAP_default_region, blocks_num);
+		__heap.region.mem_waits++;
+		__semaphore_wait_timeout((semaphore_t *)&__heap.mem_guard, time_ms);
+	}
+	return ptr_mem;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t heap_check_if_dynamic_mem(void *mem_addr)
+ *
+ * @brief	the function checks whether the given memory address comes from the address range of the heap, one of the heap regions or pools
+ *
+ * @param 	mem_addr   	memory address.
+ * @returns	TRUE - if in the heap range, FALSE - if outside the heap range.
+ **************************************************************************************************/
+
+uint8_t heap_check_if_dynamic_mem(void *mem_addr)
+{
+	return ( (__heap_find_region(mem_addr) != NULL) || (__heap_find_pool(mem_addr) != NULL) ) ? TRUE : FALSE;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t __heap_get_block_index(void *mem_addr)
+ *
+ * @brief	Used by the system to find the block of the default heap the given memory address belongs to
+ *
+ * @param 	mem_addr   	memory address.
+ * @returns	uint8_t		index of the block or HEAP_no_block if the address is outside the default heap.
+ **************************************************************************************************/
+
+uint8_t __heap_get_block_index(void *mem_addr)
+{
+	if( (mem_addr < (void *)__heap.mem_space[0x00]) ||
+		(mem_addr >= (void *)&__heap.mem_space[BOARD_heap_number_of_blocks - 0x01][BOARD_heap_single_block_size])
+	){
+		return HEAP_no_block;
+	}
+	return (uint8_t)((uint16_t)((uint8_t *)mem_addr - (uint8_t *)__heap.mem_space[0x00]) / (uint16_t)BOARD_heap_single_block_size);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void * __heap_get_block_address(uint8_t block_index)
+ *
+ * @brief	Used by the system to get the address of the heap block
+ *
+ * @param 	block_index		index of the block.
+ * @returns	void *			the address of the first byte of the block.
+ **************************************************************************************************/
+
+void * __heap_get_block_address(uint8_t block_index)
+{
+	return (void *)__heap.mem_space[block_index];
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_init(void)
+ *
+ * @brief	the function initialize the heap memory
+ *
+ **************************************************************************************************/
+
+void heap_init(void)
+{
+	__heap.region.mem_space					= __heap.mem_space[0x00];
+	__heap.region.mem_allocation_markers	= __heap.mem_allocation_markers;
+	__heap.region.mem_free_map				= __heap.mem_free_map;
+	__heap.region.mem_free_runs				= __heap.mem_free_runs;
+	__heap.region.block_size				= BOARD_heap_single_block_size;
+	__heap.region.blocks_num				= BOARD_heap_number_of_blocks;
+	__heap.region.next_region				= NULL;
+	__heap.pools							= NULL;
+	__heap_region_reset(HEAP_default_region);
+#if BOARD_heap_number_of_handles > 0
+	memset((uint8_t *)__heap.mem_handles, 0x00, sizeof(__heap.mem_handles));
+	
+	for(heap_handle_t handle = 0; handle < BOARD_heap_number_of_handles; handle++){
+		__heap.mem_handles[handle].block = HEAP_no_block;
+	}
+#endif
+	semaphore_init(&__heap.mem_guard, 1, 0);
+#if BOARD_heap_persistent_size > 0
+	__heap_persistent_attach();
+#endif
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t heap_region_init(heap_region_t *region, void *memory, uint16_t memory_size, uint16_t block_size)
+ *
+ * @brief	the function creates an independent heap region over the given memory, the blocks of the region have their own size.
+ *			The blocks are placed at the beginning of the memory, the description of the blocks at its end.
+ *			The region has to be created after the system is started and it can not be removed.
+ *
+ * @param		region			pointer to the region to create.
+ * @param		memory			memory of the region, it must not be used for anything else.
+ * @param		memory_size		size of the memory in bytes.
+ * @param		block_size		size of the single block of the region in bytes.
+ *
+ * @returns	uint8_t  number of blocks of the region (up to 255), 0 if the memory is too small.
+ **************************************************************************************************/
+
+uint8_t heap_region_init(heap_region_t *region, void *memory, uint16_t memory_size, uint16_t block_size)
+{
+	uint16_t blocks_num;
+	uint8_t irq_flag;
+	
+	if( (region == NULL) || (memory == NULL) || (block_size == 0) )return 0;
+	
+	blocks_num = memory_size / (block_size + 2);				//each block needs its marker and its counter of the free runs
+	
+	if(blocks_num > 255)blocks_num = 255;
+	
+	while( (blocks_num != 0) &&
+		   (((uint32_t)blocks_num * (block_size + 2) + ((blocks_num + 7) >> 3) + 1) > memory_size) )
+	{
+		blocks_num--;
+	}
+	if(blocks_num == 0)return 0;
+	
+	region->mem_space				= (uint8_t *)memory;
+	region->mem_allocation_markers	= region->mem_space + blocks_num * block_size;
+	region->mem_free_runs			= region->mem_allocation_markers + blocks_num;
+	region->mem_free_map			= region->mem_free_runs + blocks_num + 1;
+	region->block_size				= block_size;
+	region->blocks_num				= blocks_num;
+	__heap_region_reset(region);
+	
+	irq_flag = rtos_cli();
+	
+	if(__heap_find_region(region->mem_space) != region){		//the region created again is already linked
+		region->next_region			= __heap.region.next_region;
+		__heap.region.next_region	= region;
+	}
+	rtos_sei(irq_flag);
+	
+	return blocks_num;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint16_t heap_get_size_of_free_memory(void)
+ *
+ * @brief	the function returns the size of free space on the heap
+ *
+ * @returns	uint16_t.
+ **************************************************************************************************/
+
+uint16_t heap_get_size_of_free_memory(void)
+{
+	return ((uint16_t)__heap.region.mem_free_blocks * (uint16_t)BOARD_heap_single_block_size);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_get_stats(heap_stats_t *stats)
+ *
+ * @brief	the function copies the statistics of the heap, they are updated by every allocation and release
+ *
+ * @param		stats		pointer to the statistics to fill.
+ **************************************************************************************************/
+
+void heap_get_stats(heap_stats_t *stats)
+{
+	heap_region_get_stats(HEAP_default_region, stats);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_region_get_stats(heap_region_t *region, heap_stats_t *stats)
+ *
+ * @brief	the function copies the statistics of the heap region, the waits are counted only in the default region
+ *
+ * @param		region		pointer to the heap region.
+ * @param		stats		pointer to the statistics to fill.
+ **************************************************************************************************/
+
+void heap_region_get_stats(heap_region_t *region, heap_stats_t *stats)
+{
+	uint8_t irq_flag;
+	
+	if( (region == NULL) || (stats == NULL) )return;
+	
+	irq_flag = rtos_cli();
+	stats->free_bytes				= (uint16_t)region->mem_free_blocks * region->block_size;
+	stats->min_free_bytes			= (uint16_t)region->mem_min_free_blocks * region->block_size;
+	stats->largest_free_bytes		= (uint16_t)region->mem_largest_free_run * region->block_size;
+	stats->failed_allocations		= region->mem_failed_allocations;
+	stats->waits					= region->mem_waits;
+	stats->fragmentation			= (region->mem_free_blocks == 0) ? 0 :
+										100 - (uint8_t)(((uint16_t)region->mem_largest_free_run * 100) / region->mem_free_blocks);
+	rtos_sei(irq_flag);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_malloc_raw(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory, the memory is not cleared.
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it returns null.
+ *
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL.
+ **************************************************************************************************/
+
+void * heap_malloc_raw(uint16_t bytes_num)
+{
+	void *ptr_mem;
+	
+	if( (bytes_num == 0) || (bytes_num > (UINT16_MAX - HEAP_debug_canary_size)) )return NULL;
+	
+	ptr_mem = __heap_region_alloc(HEAP_default_region, bytes_num + HEAP_debug_canary_size);
+	
+	if(ptr_mem != NULL){
+		__heap_debug_arm(ptr_mem, bytes_num);
+	}
+	return ptr_mem;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_calloc(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory and clears all allocated blocks.
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it returns null.
+ *
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL.
+ **************************************************************************************************/
+
+void * heap_calloc(uint16_t bytes_num)
+{
+	void *ptr_mem = heap_malloc_raw(bytes_num);
+	
+	if(ptr_mem != NULL){
+		memset(ptr_mem, 0x00, (BOARD_heap_single_block_size * HEAP_debug_blocks(bytes_num)));	//the rest of the last block is cleared as well
+		__heap_debug_arm(ptr_mem, bytes_num);
+	}
+	return ptr_mem;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_malloc(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory and clears it, the same as heap_calloc().
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it returns null.
+ *
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL.
+ **************************************************************************************************/
+
+void * heap_malloc(uint16_t bytes_num)
+{
+	return heap_calloc(bytes_num);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void * __heap_malloc_raw(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory, the memory is not cleared.
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it will add the task to the waiting queue until the free blocks can hold the request.
+ *
+ * @param		bytes_num   	number of bytes.
+ *
+ * @returns	void *  memory address.
+ **************************************************************************************************/
+
+void * __heap_malloc_raw(uint16_t bytes_num)
+{
+	return __heap_wait(bytes_num, FALSE, 0);
+}
+
+
+#if BOARD_task_timeouts == TRUE
+/**********************************************************************************************//**
+ * @fn	void * __heap_malloc_raw_timeout(uint16_t bytes_num, uint16_t time_ms)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory, the memory is not cleared.
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it will add the task to the waiting queue until the free blocks can hold the request or the time runs out.
+ *
+ * @param		bytes_num   	number of bytes.
+ * @param		time_ms			timeout in ms, 0 - the task waits without a timeout.
+ *
+ * @returns	void *  memory address or NULL if the time ran out.
+ **************************************************************************************************/
+
+void * __heap_malloc_raw_timeout(uint16_t bytes_num, uint16_t time_ms)
+{
+	return __heap_wait(bytes_num, FALSE, time_ms);
+}
+#endif
+
+
+/**********************************************************************************************//**
+ * @fn	void * __heap_calloc(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory and clears it.
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it will add the task to the waiting queue until the free blocks can hold the request.
+ *
+ * @param		bytes_num   	number of bytes.
+ *
+ * @returns	void *  memory address.
+ **************************************************************************************************/
+
+void * __heap_calloc(uint16_t bytes_num)
+{
+	return __heap_wait(bytes_num, TRUE, 0);
+}
+
+
+#if BOARD_task_timeouts == TRUE
+/**********************************************************************************************//**
+ * @fn	void * __heap_calloc_timeout(uint16_t bytes_num, uint16_t time_ms)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory and clears it.
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it will add the task to the waiting queue until the free blocks can hold the request or the time runs out.
+ *
+ * @param		bytes_num   	number of bytes.
+ * @param		time_ms			timeout in ms, 0 - the task waits without a timeout.
+ *
+ * @returns	void *  memory address or NULL if the time ran out.
+ **************************************************************************************************/
+
+void * __heap_calloc_timeout(uint16_t bytes_num, uint16_t time_ms)
+{
+	return __heap_wait(bytes_num, TRUE, time_ms);
+}
+#endif
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_realloc(void *memory_addr, uint16_t bytes_num)
+ *
+ * @brief	the function changes the size of the memory allocated in the heap.
+ *			The memory is shrunk by releasing its trailing blocks and grown into the free blocks next to it,
+ *			after or before the memory, the content is moved only if the first block changes.
+ *			The content is copied to a new place only if there are not enough free blocks around the memory.
+ *			The buddy placement rounds the new size and grows the memory in place only at a multiple of the new size.
+ *			The added blocks are not cleared. The handle of the relocatable memory follows the moved or copied memory.
+ *			If memory_addr is NULL, it works as heap_malloc_raw(), if bytes_num is 0, it works as heap_free().
+ *
+ * @param		memory_addr   	memory address returned by the heap allocation.
+ * @param		bytes_num   	new number of bytes.
+ * @returns	void *  new memory address or NULL, if it is NULL, the old memory is not changed.
+ **************************************************************************************************/
+
+void * heap_realloc(void *memory_addr, uint16_t bytes_num)
+{
+	uint8_t block_index, old_blocks_num, irq_flag;
+	uint16_t blocks_num;
+	void *new_memory_addr;
+	
+	if(memory_addr == NULL)return heap_malloc_raw(bytes_num);
+	
+	if(bytes_num == 0){
+		heap_free(memory_addr);
+		return NULL;
+	}
+	block_index	= __heap_get_block_index(memory_addr);
+	
+	if( (block_index == HEAP_no_block) || (memory_addr != (void *)__heap.mem_space[block_index]) )return NULL;
+	
+	blocks_num		= __heap_placement_blocks(HEAP_default_region, HEAP_debug_blocks(bytes_num));
+	irq_flag		= rtos_cli();
+	old_blocks_num	= __heap_count_allocated_blocks(HEAP_default_region, block_index);
+	
+	if(old_blocks_num == 0){
+		rtos_sei(irq_flag);
+		return NULL;
+	}
+	
+	if(blocks_num <= old_blocks_num){
+		if(blocks_num < old_blocks_num){
+			__heap_release_blocks(HEAP_default_region, block_index + blocks_num, old_blocks_num - blocks_num);
+			__heap_hand_off();
+		}
+		__heap_debug_arm(memory_addr, bytes_num);
+		rtos_sei(irq_flag);
+		return memory_addr;
+	}
+	
+	if(blocks_num <= BOARD_heap_number_of_blocks){
+		uint8_t extra_blocks	= blocks_num - old_blocks_num;
+		uint8_t blocks_after	= __heap_count_free_run(HEAP_default_region, block_index + old_blocks_num, 1);
+		uint8_t blocks_before	= __heap_count_free_run(HEAP_default_region, block_index - 1, -1);
+		
+		if(blocks_after > extra_blocks)blocks_after = extra_blocks;
+		
+		uint8_t new_block_index = block_index - (extra_blocks - blocks_after);
+		
+		if( ((extra_blocks - blocks_after) <= blocks_before) && (__heap_placement_align(new_block_index, blocks_num) == new_block_index) ){
+			if(new_block_index != block_index){
+				__heap_take_free_blocks(HEAP_default_region, new_block_index, block_index - new_block_index);
+			}
+			if(blocks_after){
+				__heap_take_free_blocks(HEAP_default_region, block_index + old_blocks_num, blocks_after);
+			}
+			memset(&__heap.mem_allocation_markers[new_block_index], new_block_index + 1, blocks_num);	//the old blocks get the marker of the new first block as well
+#if BOARD_heap_owner_tracking == TRUE
+			__heap.mem_owners[new_block_index] = __heap.mem_owners[block_index];
+#endif
+#if BOARD_heap_number_of_handles > 0
+			heap_handle_t handle = __heap_find_handle(block_index);
+			
+			if(handle != HEAP_no_handle){
+				__heap.mem_handles[handle].block = new_block_index;
+			}
+#endif
+			rtos_sei(irq_flag);
+			
+			if(new_block_index != block_index){
+				memmove((void *)__heap.mem_space[new_block_index], memory_addr, (BOARD_heap_single_block_size * old_blocks_num));
+			}
+			__heap_debug_arm((void *)__heap.mem_space[new_block_index], bytes_num);
+			return (void *)__heap.mem_space[new_block_index];
+		}
+	}
+	rtos_sei(irq_flag);
+	
+	new_memory_addr = heap_malloc_raw(bytes_num);
+	
+	if(new_memory_addr != NULL){
+#if BOARD_heap_owner_tracking == TRUE
+		__heap.mem_owners[__heap_get_block_index(new_memory_addr)] = __heap.mem_owners[block_index];
+#endif
+		memcpy(new_memory_addr, memory_addr, (BOARD_heap_single_block_size * old_blocks_num));
+		__heap_debug_arm(new_memory_addr, bytes_num);			//the copy may cover the new canary
+#if BOARD_heap_number_of_handles > 0
+		irq_flag = rtos_cli();
+		heap_handle_t handle = __heap_find_handle(block_index);
+		
+		if(handle != HEAP_no_handle){
+			__heap.mem_handles[handle].block = __heap_get_block_index(new_memory_addr);	//heap_free() does not release the handle then
+		}
+		rtos_sei(irq_flag);
+#endif
+		heap_free(memory_addr);
+	}
+	return new_memory_addr;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_free(void *memory_addr)
+ *
+ * @brief	the function frees space in the heap memory.
+ *			the freed blocks are handed over to the waiting tasks whose request fits now.
+ *
+ * @param		memory_addr   	memory address to free.
+ **************************************************************************************************/
+
+void heap_free(void *memory_addr)
+{
+	heap_region_t *region = __heap_find_region(memory_addr);
+	
+	if(region == HEAP_default_region)
+	{	
+		uint8_t block_index = __heap_get_block_index(memory_addr);
+		uint8_t irq_flag	= rtos_cli();
+		uint8_t blocks_num	= __heap_count_allocated_blocks(HEAP_default_region, block_index);
+#if BOARD_heap_debug == TRUE
+		uint32_t err_code	= 0;
+		
+		if(__heap.mem_allocation_markers[block_index] == FREE_BLOCK_MARKER){
+			err_code	= __Err_DeviceSoftware_rtOS_HeapDoubleFree;
+			
+		}else if( (blocks_num == 0) || (memory_addr != (void *)__heap.mem_space[block_index]) ){
+			err_code	= __Err_DeviceSoftware_rtOS_HeapInvalidFree;			//the memory is kept, the address points inside it
+			blocks_num	= 0;
+			
+		}else if(__heap_debug_check_canary(block_index) == FALSE){
+			err_code	= __heap_debug_error_code(__Err_DeviceSoftware_rtOS_HeapOverrun, block_index);
+		}
+#endif
+		
+		if(blocks_num != 0){
+#if BOARD_heap_number_of_handles > 0
+			heap_handle_t handle = __heap_find_handle(block_index);
+			
+			if(handle != HEAP_no_handle){
+				__heap.mem_handles[handle].block = HEAP_no_block;
+			}
+#endif
+			__heap_release_blocks(HEAP_default_region, block_index, blocks_num);
+			__heap_hand_off();
+		}
+		rtos_sei(irq_flag);
+#if BOARD_heap_debug == TRUE
+		if(err_code != 0){
+			rtos_error(0x01, err_code);
+		}
+#endif
+		
+	}else if(region != NULL){
+		heap_region_free(region, memory_addr);
+	
+	}else{
+		heap_pool_put(__heap_find_pool(memory_addr), memory_addr);
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_region_malloc(heap_region_t *region, uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap region and clears it.
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it returns null.
+ *
+ * @param		region		pointer to the heap region, NULL - the default heap.
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL.
+ **************************************************************************************************/
+
+void * heap_region_malloc(heap_region_t *region, uint16_t bytes_num)
+{
+	void *ptr_mem;
+	
+	if( (region == NULL) || (region == HEAP_default_region) )return heap_calloc(bytes_num);
+	
+	ptr_mem = __heap_region_alloc(region, bytes_num);
+	
+	if(ptr_mem != NULL){
+		memset(ptr_mem, 0x00, bytes_num);
+	}
+	return ptr_mem;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_region_malloc_raw(heap_region_t *region, uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap region, the memory is not cleared.
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it returns null.
+ *
+ * @param		region		pointer to the heap region, NULL - the default heap.
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL.
+ **************************************************************************************************/
+
+void * heap_region_malloc_raw(heap_region_t *region, uint16_t bytes_num)
+{
+	if( (region == NULL) || (region == HEAP_default_region) )return heap_malloc_raw(bytes_num);
+	
+	return __heap_region_alloc(region, bytes_num);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_region_free(heap_region_t *region, void *memory_addr)
+ *
+ * @brief	the function frees space in the heap region, the memory outside the region is not freed.
+ *			heap_free() finds the region by itself.
+ *
+ * @param		region			pointer to the heap region, NULL - the default heap.
+ * @param		memory_addr   	memory address to free.
+ **************************************************************************************************/
+
+void heap_region_free(heap_region_t *region, void *memory_addr)
+{
+	uint8_t block_index, blocks_num, irq_flag;
+	
+	if( (region == NULL) || (region == HEAP_default_region) ){
+		if(__heap_region_contains(HEAP_default_region, memory_addr) == TRUE){
+			heap_free(memory_addr);
+		}
+		return;
+	}
+	if(__heap_region_contains(region, memory_addr) == FALSE)return;
+	
+	block_index	= (uint8_t)((uint16_t)((uint8_t *)memory_addr - region->mem_space) / region->block_size);
+	irq_flag	= rtos_cli();
+	blocks_num	= __heap_count_allocated_blocks(region, block_index);
+	
+	if(blocks_num != 0){
+		__heap_release_blocks(region, block_index, blocks_num);
+#if BOARD_heap_persistent_size > 0
+		if(region == &__heap_persistent.region){
+			__heap_persistent_forget(block_index);
+		}
+#endif
+	}
+	rtos_sei(irq_flag);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint16_t heap_pool_init(heap_pool_t *pool, void *memory, uint16_t memory_size, uint16_t block_size)
+ *
+ * @brief	the function creates a pool of fixed blocks over the given memory, the free blocks are chained by their first bytes,
+ *			so the block can not be smaller than a pointer. The pool has to be created after the system is started
+ *			and it can not be removed.
+ *
+ * @param		pool			pointer to the pool to create.
+ * @param		memory			memory of the pool, it must not be used for anything else.
+ * @param		memory_size		size of the memory in bytes.
+ * @param		block_size		size of the single block of the pool in bytes.
+ *
+ * @returns	uint16_t  number of blocks of the pool, 0 if the memory is too small.
+ **************************************************************************************************/
+
+uint16_t heap_pool_init(heap_pool_t *pool, void *memory, uint16_t memory_size, uint16_t block_size)
+{
+	uint16_t blocks_num;
+	uint8_t *block;
+	uint8_t irq_flag;
+	
+	if( (pool == NULL) || (memory == NULL) || (block_size < sizeof(void *)) )return 0;
+	
+	blocks_num = memory_size / block_size;
+	
+	if(blocks_num == 0)return 0;
+	
+	irq_flag			= rtos_cli();
+	pool->mem_space		= (uint8_t *)memory;
+	pool->mem_end		= pool->mem_space + blocks_num * block_size;
+	pool->block_size	= block_size;
+	pool->free_list		= NULL;
+	
+	for(uint16_t block_index = blocks_num; block_index != 0; block_index--){		//the first block is at the front of the list
+		block			= pool->mem_space + (block_index - 1) * block_size;
+		*(void **)block	= pool->free_list;
+		pool->free_list	= block;
+	}
+	pool->blocks_num		= blocks_num;
+	pool->free_blocks		= blocks_num;
+	pool->min_free_blocks	= blocks_num;
+	pool->empty_events		= 0;
+	
+	if(__heap_find_pool(pool->mem_space) != pool){		//the pool created again is already linked
+		pool->next_pool	= __heap.pools;
+		__heap.pools	= pool;
+	}
+	rtos_sei(irq_flag);
+	
+	return blocks_num;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_pool_get(heap_pool_t *pool)
+ *
+ * @brief	the function takes a block from the pool in constant time, the memory is not cleared.
+ *			It can be called from an interrupt, it never waits and never reports an error.
+ *
+ * @param		pool		pointer to the pool.
+ * @returns	void *  memory address or NULL if the pool is empty, the empty pool is counted.
+ **************************************************************************************************/
+
+void * heap_pool_get(heap_pool_t *pool)
+{
+	void *block;
+	uint8_t irq_flag = rtos_cli();
+	
+	block = pool->free_list;
+	
+	if(block != NULL){
+		pool->free_list = *(void **)block;
+		
+		if(--pool->free_blocks < pool->min_free_blocks){
+			pool->min_free_blocks = pool->free_blocks;
+		}
+	}else{
+		pool->empty_events++;
+	}
+	rtos_sei(irq_flag);
+	
+	return block;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_pool_put(heap_pool_t *pool, void *memory_addr)
+ *
+ * @brief	the function gives the block back to the pool in constant time, it can be called from an interrupt.
+ *			The memory outside the pool is not taken, heap_free() finds the pool by itself. An address which is not
+ *			the start of a block or a block given back to the full pool is refused and reported by rtos_error()
+ *			with __Err_DeviceSoftware_rtOS_HeapInvalidFree or __Err_DeviceSoftware_rtOS_HeapDoubleFree.
+ *			With BOARD_heap_debug the free blocks are searched as well, so any block given back twice is refused,
+ *			the time of the call grows with the number of free blocks then.
+ *
+ * @param		pool			pointer to the pool.
+ * @param		memory_addr   	memory address returned by heap_pool_get().
+ **************************************************************************************************/
+
+void heap_pool_put(heap_pool_t *pool, void *memory_addr)
+{
+	uint8_t irq_flag;
+	uint32_t err_code = 0;
+	
+	if( (pool == NULL) || ((uint8_t *)memory_addr < pool->mem_space) || ((uint8_t *)memory_addr >= pool->mem_end) )return;
+	
+	irq_flag				= rtos_cli();
+	if( (((uint8_t *)memory_addr - pool->mem_space) % pool->block_size) != 0 ){
+		err_code			= __Err_DeviceSoftware_rtOS_HeapInvalidFree;
+	}else if(pool->free_blocks == pool->blocks_num){
+		err_code			= __Err_DeviceSoftware_rtOS_HeapDoubleFree;
+	}else{
+#if BOARD_heap_debug == TRUE
+		void *block = pool->free_list;
+		
+		while( (block != NULL) && (block != memory_addr) ){
+			block = *(void **)block;
+		}
+		if(block != NULL){
+			rtos_sei(irq_flag);
+			rtos_error(0x01, __Err_DeviceSoftware_rtOS_HeapDoubleFree);
+			return;
+		}
+#endif
+		*(void **)memory_addr	= pool->free_list;
+		pool->free_list			= memory_addr;
+		pool->free_blocks++;
+	}
+	rtos_sei(irq_flag);
+	
+	if(err_code != 0){
+		rtos_error(0x01, err_code);
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_pool_get_stats(heap_pool_t *pool, heap_stats_t *stats)
+ *
+ * @brief	the function copies the statistics of the pool, failed_allocations is the number of times the pool was empty
+ *
+ * @param		pool		pointer to the pool.
+ * @param		stats		pointer to the statistics to fill.
+ **************************************************************************************************/
+
+void heap_pool_get_stats(heap_pool_t *pool, heap_stats_t *stats)
+{
+	uint8_t irq_flag;
+	
+	if( (pool == NULL) || (stats == NULL) )return;
+	
+	irq_flag = rtos_cli();
+	stats->free_bytes			= pool->free_blocks * pool->block_size;
+	stats->min_free_bytes		= pool->min_free_blocks * pool->block_size;
+	stats->largest_free_bytes	= (pool->free_blocks != 0) ? pool->block_size : 0;
+	stats->failed_allocations	= pool->empty_events;
+	stats->waits				= 0;
+	stats->fragmentation		= 0;
+	rtos_sei(irq_flag);
+}
+
+
+#if BOARD_heap_persistent_size > 0
+
+/**********************************************************************************************//**
+ * @fn	void * heap_persistent_get(const char *name)
+ *
+ * @brief	the function looks for the persistent memory allocated under the given name before the reset
+ *
+ * @param		name		name of the memory, only the first HEAP_persistent_name_size characters are compared.
+ * @returns	void *  memory address or NULL if there is no memory of this name.
+ **************************************************************************************************/
+
+void * heap_persistent_get(const char *name)
+{
+	void *ptr_mem		= NULL;
+	uint8_t irq_flag	= rtos_cli();
+	
+	for(uint8_t key = 0; key < HEAP_persistent_number_of_keys; key++){
+		if( (__heap_persistent.keys[key].block != HEAP_no_block) &&
+			(strncmp(__heap_persistent.keys[key].name, name, HEAP_persistent_name_size) == 0) )
+		{
+			ptr_mem = (void *)HEAP_region_block(&__heap_persistent.region, __heap_persistent.keys[key].block);
+			break;
+		}
+	}
+	rtos_sei(irq_flag);
+	
+	return ptr_mem;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_persistent_malloc(const char *name, uint16_t bytes_num)
+ *
+ * @brief	the function returns the persistent memory of the given name, its content is kept over the watchdog and brown-out reset.
+ *			If there is no memory of this name yet, it is allocated and cleared.
+ *			The memory is released with heap_free(), the name is released with it.
+ *
+ * @param		name		name of the memory, only the first HEAP_persistent_name_size characters are kept.
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL if there is no free memory or no free key, or the memory of this name is smaller.
+ **************************************************************************************************/
+
+void * heap_persistent_malloc(const char *name, uint16_t bytes_num)
+{
+	heap_region_t *region	= &__heap_persistent.region;
+	uint8_t *ptr_mem		= heap_persistent_get(name);
+	uint8_t block_index, irq_flag;
+	
+	if(ptr_mem != NULL){
+		block_index = (uint8_t)((uint16_t)(ptr_mem - region->mem_space) / region->block_size);
+		
+		if(((uint16_t)__heap_count_allocated_blocks(region, block_index) * region->block_size) < bytes_num){
+			return NULL;
+		}
+		return ptr_mem;
+	}
+	ptr_mem = heap_region_malloc(region, bytes_num);
+	
+	if(ptr_mem == NULL){
+		irq_flag					= rtos_cli();
+		__heap_persistent.checksum	= __heap_persistent_checksum();		//the failed allocation is counted in the region
+		rtos_sei(irq_flag);
+		return NULL;
+	}
+	
+	block_index	= (uint8_t)((uint16_t)(ptr_mem - region->mem_space) / region->block_size);
+	irq_flag	= rtos_cli();
+	
+	for(uint8_t key = 0; key < HEAP_persistent_number_of_keys; key++){
+		if(__heap_persistent.keys[key].block == HEAP_no_block){
+			strncpy(__heap_persistent.keys[key].name, name, HEAP_persistent_name_size);
+			__heap_persistent.keys[key].block	= block_index;
+			__heap_persistent.checksum			= __heap_persistent_checksum();
+			rtos_sei(irq_flag);
+			return ptr_mem;
+		}
+	}
+	rtos_sei(irq_flag);
+	heap_free(ptr_mem);
+	rtos_error(0x01, __Err_DeviceSoftware_rtOS_DynamicMemory);
+	
+	return NULL;
+}
+
+#endif
+
+
+#if BOARD_heap_debug == TRUE
+
+/**********************************************************************************************//**
+ * @fn	void __heap_debug_check(void)
+ *
+ * @brief	Used by the idle task to check the canaries of all allocations of the default heap,
+ *			the interrupts are disabled only while one allocation is checked.
+ *			The overrun is reported with __Err_DeviceSoftware_rtOS_HeapOverrun.
+ *
+ **************************************************************************************************/
+
+void __heap_debug_check(void)
+{
+	uint8_t block_index = 0;
+	
+	while(block_index < BOARD_heap_number_of_blocks){
+		uint32_t err_code	= 0;
+		uint8_t irq_flag	= rtos_cli();
+		uint8_t blocks_num	= __heap_count_allocated_blocks(HEAP_default_region, block_index);
+		
+		if( (blocks_num != 0) && (__heap_debug_check_canary(block_index) == FALSE) ){
+			err_code = __heap_debug_error_code(__Err_DeviceSoftware_rtOS_HeapOverrun, block_index);
+		}
+		rtos_sei(irq_flag);
+		
+		if(err_code != 0){
+			rtos_error(0x01, err_code);
+		}
+		block_index += (blocks_num != 0) ? blocks_num : 1;
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t heap_debug_report_leaks(void)
+ *
+ * @brief	the function reports every memory still allocated in the default heap by rtos_error() with __Err_DeviceSoftware_rtOS_HeapLeak,
+ *			the low word of the error code is the code address of the owner task or, if the owner is unknown, the number of the first block + 1.
+ *
+ * @returns	uint8_t  number of the allocations still in the heap.
+ **************************************************************************************************/
+
+uint8_t heap_debug_report_leaks(void)
+{
+	uint8_t block_index = 0;
+	uint8_t leaks		= 0;
+	
+	while(block_index < BOARD_heap_number_of_blocks){
+		uint32_t err_code	= 0;
+		uint8_t irq_flag	= rtos_cli();
+		uint8_t blocks_num	= __heap_count_allocated_blocks(HEAP_default_region, block_index);
+		
+		if(blocks_num != 0){
+			err_code = __heap_debug_error_code(__Err_DeviceSoftware_rtOS_HeapLeak, block_index);
+			leaks++;
+		}
+		rtos_sei(irq_flag);
+		
+		if(err_code != 0){
+			rtos_error(0x01, err_code);
+		}
+		block_index += (blocks_num != 0) ? blocks_num : 1;
+	}
+	return leaks;
+}
+
+#endif
+
+#if BOARD_heap_owner_tracking == TRUE
+
+/**********************************************************************************************//**
+ * @fn	void __heap_set_owner(void *memory_addr, task_handle_t *task)
+ *
+ * @brief	Used by the system to change the owner of the allocated memory,
+ *			the memory without an owner (NULL) is never freed by heap_free_task_memory()
+ *
+ * @param		memory_addr   	memory address returned by the heap allocation.
+ * @param		task			new owner of the memory.
+ **************************************************************************************************/
+
+void __heap_set_owner(void *memory_addr, task_handle_t *task)
+{
+	uint8_t block_index = __heap_get_block_index(memory_addr);
+	
+	if(block_index != HEAP_no_block){
+		__heap.mem_owners[block_index] = task;
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void __heap_clear_owner(task_handle_t *task)
+ *
+ * @brief	Used by the system before the task handle is freed, the memory allocated by the task is left without an owner,
+ *			so a new task created at the same address does not take it over.
+ *
+ * @param		task			the task whose memory is left without an owner.
+ **************************************************************************************************/
+
+void __heap_clear_owner(task_handle_t *task)
+{
+	uint8_t irq_flag = rtos_cli();
+	
+	for(uint8_t block_index = 0; block_index < BOARD_heap_number_of_blocks; block_index++){
+		if(__heap.mem_owners[block_index] == task){
+			__heap.mem_owners[block_index] = NULL;
+		}
+	}
+	rtos_sei(irq_flag);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint16_t heap_get_usage(task_handle_t *task=task_this())
+ *
+ * @brief	the function returns the size of the heap memory allocated by the task
+ *
+ * @param	task   	pointer to the task, by default this function argument is null
+ *					it means call this function for currently running task
+ *
+ * @returns	uint16_t  number of bytes, the whole blocks are counted.
+ **************************************************************************************************/
+
+uint16_t _heap_get_usage(task_handle_t *task)
+{
+	uint8_t blocks_num = 0;
+	uint8_t irq_flag;
+	
+	if(task == NULL)task = task_this();
+	if(task == NULL)return 0;
+	
+	irq_flag = rtos_cli();
+	
+	for(uint8_t block_index = 0; block_index < BOARD_heap_number_of_blocks; block_index++){
+		uint8_t marker = __heap.mem_allocation_markers[block_index];
+		
+		if( (marker != FREE_BLOCK_MARKER) && (__heap.mem_owners[marker - 1] == task) ){
+			blocks_num++;
+		}
+	}
+	rtos_sei(irq_flag);
+	
+	return ((uint16_t)blocks_num * (uint16_t)BOARD_heap_single_block_size);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_free_task_memory(task_handle_t *task)
+ *
+ * @brief	the function frees all the heap memory allocated by the task in one pass over the blocks,
+ *			the memory of the task handle itself is not freed.
+ *			the freed blocks are handed over to the waiting tasks whose request fits now.
+ *
+ * @param	task   	pointer to the task.
+ **************************************************************************************************/
+
+void heap_free_task_memory(task_handle_t *task)
+{
+	uint8_t block_index = 0;
+	uint8_t irq_flag;
+	
+	if(task == NULL)return;
+	
+	irq_flag = rtos_cli();
+	
+	while(block_index < BOARD_heap_number_of_blocks){
+		uint8_t blocks_num = 1;
+		
+		if( (__heap.mem_allocation_markers[block_index] == (block_index + 1)) &&
+			(__heap.mem_owners[block_index] == task) &&
+			((void *)__heap.mem_space[block_index] != (void *)task) )
+		{
+			blocks_num = __heap_count_allocated_blocks(HEAP_default_region, block_index);
+#if BOARD_heap_number_of_handles > 0
+			heap_handle_t handle = __heap_find_handle(block_index);
+			
+			if(handle != HEAP_no_handle){
+				__heap.mem_handles[handle].block = HEAP_no_block;
+			}
+#endif
+			__heap_release_blocks(HEAP_default_region, block_index, blocks_num);
+		}
+		block_index += blocks_num;
+	}
+	__heap_hand_off();
+	rtos_sei(irq_flag);
+}
+
+#endif
+
+
+#if BOARD_heap_number_of_handles > 0
+
+/**********************************************************************************************//**
+ * @fn	heap_handle_t heap_handle_malloc(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of relocatable memory in the heap and clears it.
+ *			The memory can be moved by the heap compaction while it is not locked,
+ *			use heap_handle_lock() to get its address.
+ *
+ * @param		bytes_num   number of bytes.
+ * @returns	heap_handle_t  handle of the memory or HEAP_no_handle if there is no free memory or no free handle.
+ **************************************************************************************************/
+
+heap_handle_t heap_handle_malloc(uint16_t bytes_num)
+{
+	uint8_t irq_flag;
+	void *ptr_mem = heap_malloc(bytes_num);
+	
+	if(ptr_mem == NULL)return HEAP_no_handle;
+	
+	irq_flag = rtos_cli();
+	
+	for(heap_handle_t handle = 0; handle < BOARD_heap_number_of_handles; handle++){
+		if(__heap.mem_handles[handle].block == HEAP_no_block){
+			__heap.mem_handles[handle].block = __heap_get_block_index(ptr_mem);
+			__heap.mem_handles[handle].locks = 0;
+			rtos_sei(irq_flag);
+			return handle;
+		}
+	}
+	rtos_sei(irq_flag);
+	heap_free(ptr_mem);
+	rtos_error(0x01, __Err_DeviceSoftware_rtOS_DynamicMemory);
+	
+	return HEAP_no_handle;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_handle_lock(heap_handle_t handle)
+ *
+ * @brief	the function pins the relocatable memory and returns its address, the address is valid until the memory is unlocked.
+ *			The locks are counted, the memory can be moved again after the same number of heap_handle_unlock() calls.
+ *
+ * @param		handle		handle of the memory.
+ * @returns	void *  memory address or NULL if the handle is not used.
+ **************************************************************************************************/
+
+void * heap_handle_lock(heap_handle_t handle)
+{
+	void *ptr_mem = NULL;
+	uint8_t irq_flag;
+	
+	if(handle >= BOARD_heap_number_of_handles)return NULL;
+	
+	irq_flag = rtos_cli();
+	
+	if(__heap.mem_handles[handle].block != HEAP_no_block){
+		if(__heap.mem_handles[handle].locks != 0xFF){
+			__heap.mem_handles[handle].locks++;
+		}
+		ptr_mem = (void *)__heap.mem_space[__heap.mem_handles[handle].block];
+	}
+	rtos_sei(irq_flag);
+	
+	return ptr_mem;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_handle_unlock(heap_handle_t handle)
+ *
+ * @brief	the function releases one lock of the relocatable memory, the address returned by heap_handle_lock()
+ *			must not be used after the last lock is released.
+ *
+ * @param		handle		handle of the memory.
+ **************************************************************************************************/
+
+void heap_handle_unlock(heap_handle_t handle)
+{
+	uint8_t irq_flag;
+	
+	if(handle >= BOARD_heap_number_of_handles)return;
+	
+	irq_flag = rtos_cli();
+	
+	if(__heap.mem_handles[handle].locks != 0){
+		__heap.mem_handles[handle].locks--;
+	}
+	rtos_sei(irq_flag);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_handle_free(heap_handle_t handle)
+ *
+ * @brief	the function frees the relocatable memory and the handle, locked or not.
+ *
+ * @param		handle		handle of the memory.
+ **************************************************************************************************/
+
+void heap_handle_free(heap_handle_t handle)
+{
+	uint8_t block_index;
+	
+	if(handle >= BOARD_heap_number_of_handles)return;
+	
+	block_index = __heap.mem_handles[handle].block;
+	
+	if(block_index != HEAP_no_block){
+		heap_free((void *)__heap.mem_space[block_index]);		//the handle is released by heap_free()
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t __heap_compact_step(void)
+ *
+ * @brief	Used by the idle task to compact the heap. The function slides the first unlocked relocatable memory
+ *			which has free blocks in front of it down over these blocks, only one memory is moved per call.
+ *			The buddy placement moves the memory only to a multiple of its size.
+ *			The interrupts are disabled only while one allocation is checked and while the markers, the map
+ *			and the handle are updated, the data are moved with the interrupts enabled. The target blocks are
+ *			reserved and the memory is locked during the move, so the interrupts must not lock the relocatable
+ *			memory. The waiting tasks get the memory which became free.
+ *
+ * @returns	uint8_t		TRUE - the memory has been moved, FALSE - there is nothing to move.
+ **************************************************************************************************/
+
+uint8_t __heap_compact_step(void)
+{
+	uint8_t block_index = 0;
+	uint8_t alloc_index, blocks_num, reserved_num, target_index;
+	heap_handle_t handle = HEAP_no_handle;
+	uint8_t irq_flag;
+	
+	while(block_index < BOARD_heap_number_of_blocks){
+		uint8_t free_run;
+		
+		irq_flag = rtos_cli();
+		free_run = __heap_count_free_run(HEAP_default_region, block_index, 1);
+		
+		if(free_run == 0){
+			blocks_num	= __heap_count_allocated_blocks(HEAP_default_region, block_index);
+			rtos_sei(irq_flag);
+			block_index	+= (blocks_num != 0) ? blocks_num : 1;
+			continue;
+		}
+		alloc_index = block_index + free_run;
+		
+		if(alloc_index >= BOARD_heap_number_of_blocks){
+			rtos_sei(irq_flag);
+			return FALSE;
+		}
+		blocks_num	= __heap_count_allocated_blocks(HEAP_default_region, alloc_index);
+		handle		= __heap_find_handle(alloc_index);
+		
+		target_index = __heap_placement_align(block_index, blocks_num);
+		
+		if( (handle != HEAP_no_handle) && (__heap.mem_handles[handle].locks == 0) && (target_index < alloc_index) ){
+			block_index		= target_index;
+			reserved_num	= ((alloc_index - block_index) < blocks_num) ? (alloc_index - block_index) : blocks_num;
+			__heap_take_blocks(HEAP_default_region, block_index, reserved_num, NULL);	//the target blocks cannot be allocated during the move
+#if BOARD_heap_debug == TRUE
+			__heap.mem_sizes[block_index] = HEAP_debug_no_canary;
+#endif
+			__heap.mem_handles[handle].locks = 1;										//the memory is not moved twice
+			rtos_sei(irq_flag);
+			break;
+		}
+		rtos_sei(irq_flag);
+		block_index = alloc_index + ((blocks_num != 0) ? blocks_num : 1);
+	}
+	if(block_index >= BOARD_heap_number_of_blocks)return FALSE;
+	
+	memmove((void *)__heap.mem_space[block_index], (void *)__heap.mem_space[alloc_index], (BOARD_heap_single_block_size * blocks_num));
+	
+	irq_flag = rtos_cli();
+	__heap_release_blocks(HEAP_default_region, block_index, reserved_num);
+	
+	if( (__heap.mem_handles[handle].block == alloc_index) && (__heap_count_allocated_blocks(HEAP_default_region, alloc_index) == blocks_num) ){
+#if BOARD_heap_owner_tracking == TRUE
+		task_handle_t *owner = __heap.mem_owners[alloc_index];
+#else
+		task_handle_t *owner = NULL;
+#endif
+		__heap_release_blocks(HEAP_default_region, alloc_index, blocks_num);
+		__heap_take_blocks(HEAP_default_region, block_index, blocks_num, owner);
+#if BOARD_heap_debug == TRUE
+		__heap.mem_sizes[block_index] = __heap.mem_sizes[alloc_index];
+#endif
+		__heap.mem_handles[handle].block = block_index;
+		__heap.mem_handles[handle].locks = 0;
+		__heap_hand_off();
+		rtos_sei(irq_flag);
+		return TRUE;
+	}
+	__heap_hand_off();															//the memory has been freed by an interrupt during the move
+	rtos_sei(irq_flag);
+	
+	return FALSE;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t heap_compact(void)
+ *
+ * @brief	the function compacts the whole heap, all unlocked relocatable memory is moved down as far as possible.
+ *			The heap is compacted in the idle time as well.
+ *
+ * @returns	uint8_t		number of memories moved.
+ **************************************************************************************************/
+
+uint8_t heap_compact(void)
+{
+	uint8_t moved = 0;
+	
+	while( (moved != 0xFF) && (__heap_compact_step() == TRUE) ){
+		moved++;
+	}
+	return moved;
+}
+
+#endif
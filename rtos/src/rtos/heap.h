@@ -10,13 +10,106 @@
 #define HEAP_H_
 
 
-void * __heap_malloc(uint16_t bytes_num);
+#define HEAP_no_block	0xFF
+#define HEAP_no_handle	0xFF
+
+#define HEAP_placement_first_fit		0		//the values of BOARD_heap_placement
+#define HEAP_placement_best_fit			1
+#define HEAP_placement_next_fit			2
+#define HEAP_placement_buddy			3
+
+#define HEAP_persistent_name_size		8		//number of characters of the name of the persistent memory
+#define HEAP_persistent_number_of_keys	8		//number of the persistent memories
+
+#if BOARD_heap_debug == TRUE
+#define HEAP_debug_canary_size			2		//number of bytes guarding the end of every allocation of the default heap
+#else
+#define HEAP_debug_canary_size			0
+#endif
+
+typedef uint8_t heap_handle_t;
+
+
+/**********************************************************************************************//**
+ * @struct	heap_stats_t
+ *
+ * @brief	the statistics of the heap
+ **************************************************************************************************/
+
+typedef struct{
+	uint16_t	free_bytes;				//size of free memory
+	uint16_t	min_free_bytes;			//the lowest size of free memory since the heap initialization
+	uint16_t	largest_free_bytes;		//the largest allocation that can succeed now
+	uint16_t	failed_allocations;		//number of allocations which have failed because of missing memory
+	uint16_t	waits;					//number of times a task has been added to the queue of tasks waiting for memory
+	uint8_t		fragmentation;			//percentage of free memory outside the largest run of free blocks
+
+}heap_stats_t;
+
+
+/**********************************************************************************************//**
+ * @struct	heap_region_t
+ *
+ * @brief	the independent heap region with its own block size, created by heap_region_init()
+ **************************************************************************************************/
+
+typedef struct heap_region{
+	uint8_t				*mem_space;					//the first block
+	uint8_t				*mem_allocation_markers;	//the owner of the block (index of the first block + 1)
+	uint8_t				*mem_free_map;				//bit n is set if the block n is free
+	uint8_t				*mem_free_runs;				//number of runs of free blocks for each length, the lengths are updated on every change
+	uint16_t			block_size;
+	uint8_t				blocks_num;
+	uint8_t				mem_free_blocks;
+	uint8_t				mem_largest_free_run;		//the length of the longest run of free blocks
+	uint8_t				mem_min_free_blocks;		//the lowest number of free blocks since the initialization
+	uint16_t			mem_failed_allocations;
+	uint16_t			mem_waits;					//number of times a task has been added to the waiting queue
+#if BOARD_heap_placement == HEAP_placement_next_fit
+	uint8_t				mem_next_fit;				//the byte of the map of free blocks the next search starts from
+#endif
+	struct heap_region	*next_region;
+
+}heap_region_t;
+
+
+/**********************************************************************************************//**
+ * @struct	heap_pool_t
+ *
+ * @brief	the pool of fixed blocks for the interrupts, created by heap_pool_init()
+ **************************************************************************************************/
+
+typedef struct heap_pool{
+	uint8_t				*mem_space;					//the first block
+	uint8_t				*mem_end;					//the first byte after the last block
+	void				*free_list;					//the free blocks are chained by their first bytes
+	uint16_t			block_size;
+	uint16_t			blocks_num;
+	uint16_t			free_blocks;
+	uint16_t			min_free_blocks;			//the lowest number of free blocks since the initialization
+	uint16_t			empty_events;				//number of heap_pool_get() calls which found the pool empty
+	struct heap_pool	*next_pool;
+
+}heap_pool_t;
+
+
+void * __heap_malloc_raw(uint16_t bytes_num);
+void * __heap_calloc(uint16_t bytes_num);
+#if BOARD_task_timeouts == TRUE
+void * __heap_malloc_raw_timeout(uint16_t bytes_num, uint16_t time_ms);
+void * __heap_calloc_timeout(uint16_t bytes_num, uint16_t time_ms);
+#endif
+uint8_t __heap_get_block_index(void *mem_addr);
+void * __heap_get_block_address(uint8_t block_index);
+void __heap_set_owner(void *memory_addr, task_handle_t *task);
+void __heap_clear_owner(task_handle_t *task);
+uint8_t __heap_compact_step(void);
 
 
 /**********************************************************************************************//**
  * @fn	uint8_t heap_check_if_dynamic_mem(void *mem_addr)
  *
- * @brief	the function checks whether the given memory address comes from the heap address range
+ * @brief	the function checks whether the given memory address comes from the address range of the heap, one of the heap regions or pools
  *
  * @param 	mem_addr   	memory address.
  * @returns	TRUE - if in the heap range, FALSE - if outside the heap range.
@@ -43,10 +136,20 @@ void heap_init(void);
 uint16_t heap_get_size_of_free_memory(void);
 
 
+/**********************************************************************************************//**
+ * @fn	void heap_get_stats(heap_stats_t *stats)
+ *
+ * @brief	the function copies the statistics of the heap, they are updated by every allocation and release
+ *
+ * @param		stats		pointer to the statistics to fill.
+ **************************************************************************************************/
+void heap_get_stats(heap_stats_t *stats);
+
+
 /**********************************************************************************************//**
  * @fn	void * condWait_heap_malloc(uint16_t bytes_num)
  *
- * @brief	the function allocates the requested amount of space in the heap memory.
+ * @brief	the function allocates the requested amount of space in the heap memory and clears it, the same as condWait_heap_calloc().
  *			the function returns the address of available memory or, if it is missing,
  *			it adds the currently running task to the waiting queue.
  *
@@ -54,13 +157,92 @@ uint16_t heap_get_size_of_free_memory(void);
  * @returns	void *  memory address.
  **************************************************************************************************/
 #define condWait_heap_malloc(byte_num)\
-			task_update_pc_addr_before_call(__heap_malloc(byte_num))
+			task_update_pc_addr_before_call(__heap_calloc(byte_num))
+
+
+/**********************************************************************************************//**
+ * @fn	void * condWait_heap_malloc_raw(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory, the memory is not cleared.
+ *			the function returns the address of available memory or, if it is missing,
+ *			it adds the currently running task to the waiting queue.
+ *
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address.
+ **************************************************************************************************/
+#define condWait_heap_malloc_raw(byte_num)\
+			task_update_pc_addr_before_call(__heap_malloc_raw(byte_num))
+
+
+/**********************************************************************************************//**
+ * @fn	void * condWait_heap_calloc(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory and clears it.
+ *			the function returns the address of available memory or, if it is missing,
+ *			it adds the currently running task to the waiting queue.
+ *
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address.
+ **************************************************************************************************/
+#define condWait_heap_calloc(byte_num)\
+			task_update_pc_addr_before_call(__heap_calloc(byte_num))
+
+
+#if BOARD_task_timeouts == TRUE
+
+/**********************************************************************************************//**
+ * @fn	void * condWait_heap_malloc_timeout(uint16_t bytes_num, uint16_t time_ms)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory and clears it, the same as condWait_heap_calloc_timeout().
+ *			the function returns the address of available memory or, if it is missing,
+ *			it adds the currently running task to the waiting queue until the memory is available or the time runs out.
+ *			If the time is equal to 0, the task waits without a timeout.
+ *
+ * @param		bytes_num   number of bytes.
+ * @param		time_ms		timeout in ms.
+ * @returns	void *  memory address or NULL if the time ran out.
+ **************************************************************************************************/
+#define condWait_heap_malloc_timeout(byte_num, time_ms)\
+			task_update_pc_addr_before_call(__heap_calloc_timeout(byte_num, time_ms))
+
+
+/**********************************************************************************************//**
+ * @fn	void * condWait_heap_malloc_raw_timeout(uint16_t bytes_num, uint16_t time_ms)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory, the memory is not cleared.
+ *			the function returns the address of available memory or, if it is missing,
+ *			it adds the currently running task to the waiting queue until the memory is available or the time runs out.
+ *			If the time is equal to 0, the task waits without a timeout.
+ *
+ * @param		bytes_num   number of bytes.
+ * @param		time_ms		timeout in ms.
+ * @returns	void *  memory address or NULL if the time ran out.
+ **************************************************************************************************/
+#define condWait_heap_malloc_raw_timeout(byte_num, time_ms)\
+			task_update_pc_addr_before_call(__heap_malloc_raw_timeout(byte_num, time_ms))
+
+
+/**********************************************************************************************//**
+ * @fn	void * condWait_heap_calloc_timeout(uint16_t bytes_num, uint16_t time_ms)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory and clears it.
+ *			the function returns the address of available memory or, if it is missing,
+ *			it adds the currently running task to the waiting queue until the memory is available or the time runs out.
+ *			If the time is equal to 0, the task waits without a timeout.
+ *
+ * @param		bytes_num   number of bytes.
+ * @param		time_ms		timeout in ms.
+ * @returns	void *  memory address or NULL if the time ran out.
+ **************************************************************************************************/
+#define condWait_heap_calloc_timeout(byte_num, time_ms)\
+			task_update_pc_addr_before_call(__heap_calloc_timeout(byte_num, time_ms))
+#endif
 
 
 /**********************************************************************************************//**
  * @fn	void * heap_malloc(uint16_t bytes_num)
  *
- * @brief	the function allocates the requested amount of space in the heap memory.
+ * @brief	the function allocates the requested amount of space in the heap memory and clears it, the same as heap_calloc().
  *			the function returns the address of available memory or, if it is missing, 
  *			it returns null.
  *
@@ -69,15 +251,323 @@ uint16_t heap_get_size_of_free_memory(void);
  **************************************************************************************************/
 void * heap_malloc(uint16_t bytes_num);
 
+
+/**********************************************************************************************//**
+ * @fn	void * heap_malloc_raw(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory, the memory is not cleared.
+ *			Use it for buffers which are filled right after the allocation.
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it returns null.
+ *
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL.
+ **************************************************************************************************/
+void * heap_malloc_raw(uint16_t bytes_num);
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_calloc(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap memory and clears all allocated blocks.
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it returns null.
+ *
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL.
+ **************************************************************************************************/
+void * heap_calloc(uint16_t bytes_num);
+
 			
+/**********************************************************************************************//**
+ * @fn	void * heap_realloc(void *memory_addr, uint16_t bytes_num)
+ *
+ * @brief	the function changes the size of the memory allocated in the heap.
+ *			The memory is shrunk by releasing its trailing blocks and grown into the free blocks next to it,
+ *			after or before the memory, the content is moved only if the first block changes.
+ *			The content is copied to a new place only if there are not enough free blocks around the memory.
+ *			The added blocks are not cleared. If memory_addr is NULL, it works as heap_malloc_raw(),
+ *			if bytes_num is 0, it works as heap_free().
+ *
+ * @param		memory_addr   	memory address returned by the heap allocation.
+ * @param		bytes_num   	new number of bytes.
+ * @returns	void *  new memory address or NULL, if it is NULL, the old memory is not changed.
+ **************************************************************************************************/
+void * heap_realloc(void *memory_addr, uint16_t bytes_num);
+
+
 /**********************************************************************************************//**
  * @fn	void heap_free(void *memory_addr)
  *
  * @brief	the function frees space in the heap memory.
+ *			the freed blocks are handed over to the waiting tasks whose request fits now.
  *
  * @param		memory_addr   	memory address to free.
  **************************************************************************************************/
 void heap_free(void *memory_addr);
 
 
+/**********************************************************************************************//**
+ * @fn	uint8_t heap_region_init(heap_region_t *region, void *memory, uint16_t memory_size, uint16_t block_size)
+ *
+ * @brief	the function creates an independent heap region over the given memory, the blocks of the region have their own size.
+ *			The blocks are placed at the beginning of the memory, the description of the blocks at its end.
+ *			The region has to be created after the system is started and it can not be removed.
+ *
+ * @param		region			pointer to the region to create.
+ * @param		memory			memory of the region, it must not be used for anything else.
+ * @param		memory_size		size of the memory in bytes.
+ * @param		block_size		size of the single block of the region in bytes.
+ *
+ * @returns	uint8_t  number of blocks of the region (up to 255), 0 if the memory is too small.
+ **************************************************************************************************/
+uint8_t heap_region_init(heap_region_t *region, void *memory, uint16_t memory_size, uint16_t block_size);
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_region_malloc(heap_region_t *region, uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap region and clears it.
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it returns null.
+ *
+ * @param		region		pointer to the heap region, NULL - the default heap.
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL.
+ **************************************************************************************************/
+void * heap_region_malloc(heap_region_t *region, uint16_t bytes_num);
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_region_malloc_raw(heap_region_t *region, uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space in the heap region, the memory is not cleared.
+ *			the function returns the address of available memory or, if it is missing, 
+ *			it returns null.
+ *
+ * @param		region		pointer to the heap region, NULL - the default heap.
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL.
+ **************************************************************************************************/
+void * heap_region_malloc_raw(heap_region_t *region, uint16_t bytes_num);
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_region_free(heap_region_t *region, void *memory_addr)
+ *
+ * @brief	the function frees space in the heap region, the memory outside the region is not freed.
+ *			heap_free() finds the region by itself.
+ *
+ * @param		region			pointer to the heap region, NULL - the default heap.
+ * @param		memory_addr   	memory address to free.
+ **************************************************************************************************/
+void heap_region_free(heap_region_t *region, void *memory_addr);
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_region_get_stats(heap_region_t *region, heap_stats_t *stats)
+ *
+ * @brief	the function copies the statistics of the heap region, the waits are counted only in the default region
+ *
+ * @param		region		pointer to the heap region.
+ * @param		stats		pointer to the statistics to fill.
+ **************************************************************************************************/
+void heap_region_get_stats(heap_region_t *region, heap_stats_t *stats);
+
+
+/**********************************************************************************************//**
+ * @fn	uint16_t heap_pool_init(heap_pool_t *pool, void *memory, uint16_t memory_size, uint16_t block_size)
+ *
+ * @brief	the function creates a pool of fixed blocks over the given memory, the free blocks are chained by their first bytes,
+ *			so the block can not be smaller than a pointer. The pool has to be created after the system is started
+ *			and it can not be removed.
+ *
+ * @param		pool			pointer to the pool to create.
+ * @param		memory			memory of the pool, it must not be used for anything else.
+ * @param		memory_size		size of the memory in bytes.
+ * @param		block_size		size of the single block of the pool in bytes.
+ *
+ * @returns	uint16_t  number of blocks of the pool, 0 if the memory is too small.
+ **************************************************************************************************/
+uint16_t heap_pool_init(heap_pool_t *pool, void *memory, uint16_t memory_size, uint16_t block_size);
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_pool_get(heap_pool_t *pool)
+ *
+ * @brief	the function takes a block from the pool in constant time, the memory is not cleared.
+ *			It can be called from an interrupt, it never waits and never reports an error.
+ *
+ * @param		pool		pointer to the pool.
+ * @returns	void *  memory address or NULL if the pool is empty, the empty pool is counted.
+ **************************************************************************************************/
+void * heap_pool_get(heap_pool_t *pool);
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_pool_put(heap_pool_t *pool, void *memory_addr)
+ *
+ * @brief	the function gives the block back to the pool in constant time, it can be called from an interrupt.
+ *			The memory outside the pool is not taken, heap_free() finds the pool by itself.
+ *			With BOARD_heap_debug the free blocks are searched, a block given back twice is refused and reported.
+ *
+ * @param		pool			pointer to the pool.
+ * @param		memory_addr   	memory address returned by heap_pool_get().
+ **************************************************************************************************/
+void heap_pool_put(heap_pool_t *pool, void *memory_addr);
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_pool_get_stats(heap_pool_t *pool, heap_stats_t *stats)
+ *
+ * @brief	the function copies the statistics of the pool, failed_allocations is the number of times the pool was empty
+ *
+ * @param		pool		pointer to the pool.
+ * @param		stats		pointer to the statistics to fill.
+ **************************************************************************************************/
+void heap_pool_get_stats(heap_pool_t *pool, heap_stats_t *stats);
+
+
+#if BOARD_heap_persistent_size > 0
+
+/**********************************************************************************************//**
+ * @fn	void * heap_persistent_get(const char *name)
+ *
+ * @brief	the function looks for the persistent memory allocated under the given name before the reset
+ *
+ * @param		name		name of the memory, only the first HEAP_persistent_name_size characters are compared.
+ * @returns	void *  memory address or NULL if there is no memory of this name.
+ **************************************************************************************************/
+void * heap_persistent_get(const char *name);
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_persistent_malloc(const char *name, uint16_t bytes_num)
+ *
+ * @brief	the function returns the persistent memory of the given name, its content is kept over the watchdog and brown-out reset.
+ *			If there is no memory of this name yet, it is allocated and cleared.
+ *			The memory is released with heap_free(), the name is released with it.
+ *
+ * @param		name		name of the memory, only the first HEAP_persistent_name_size characters are kept.
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL if there is no free memory or no free key, or the memory of this name is smaller.
+ **************************************************************************************************/
+void * heap_persistent_malloc(const char *name, uint16_t bytes_num);
+
+#endif
+
+
+#if BOARD_heap_debug == TRUE
+
+/**********************************************************************************************//**
+ * @fn	uint8_t heap_debug_report_leaks(void)
+ *
+ * @brief	the function reports every memory still allocated in the default heap by rtos_error() with __Err_DeviceSoftware_rtOS_HeapLeak,
+ *			the low word of the error code is the code address of the owner task or, if the owner is unknown, the number of the first block + 1.
+ *			Call it when all memory should be free, e.g. after the tasks are erased.
+ *
+ * @returns	uint8_t  number of the allocations still in the heap.
+ **************************************************************************************************/
+uint8_t heap_debug_report_leaks(void);
+
+void __heap_debug_check(void);
+void __heap_debug_disarm(void *memory_addr);
+
+#endif
+
+
+#if BOARD_heap_owner_tracking == TRUE
+
+/**********************************************************************************************//**
+ * @fn	uint16_t heap_get_usage(task_handle_t *task=task_this())
+ *
+ * @brief	the function returns the size of the heap memory allocated by the task
+ *
+ * @param	task   	pointer to the task, by default this function argument is null
+ *					it means call this function for currently running task
+ *
+ * @returns	uint16_t  number of bytes, the whole blocks are counted.
+ **************************************************************************************************/
+uint16_t _heap_get_usage(task_handle_t *task);
+#define heap_get_usage(...)			VRG(_heap_get_usage, __VA_ARGS__)
+#define _heap_get_usage0()			_heap_get_usage(NULL)
+#define _heap_get_usage1(task)		_heap_get_usage(task)
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_free_task_memory(task_handle_t *task)
+ *
+ * @brief	the function frees all the heap memory allocated by the task in one pass over the blocks,
+ *			the memory of the task handle itself is not freed.
+ *			the freed blocks are handed over to the waiting tasks whose request fits now.
+ *
+ * @param	task   	pointer to the task.
+ **************************************************************************************************/
+void heap_free_task_memory(task_handle_t *task);
+
+#endif
+
+
+#if BOARD_heap_number_of_handles > 0
+
+/**********************************************************************************************//**
+ * @fn	heap_handle_t heap_handle_malloc(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of relocatable memory in the heap and clears it.
+ *			The memory can be moved by the heap compaction while it is not locked,
+ *			use heap_handle_lock() to get its address.
+ *
+ * @param		bytes_num   number of bytes.
+ * @returns	heap_handle_t  handle of the memory or HEAP_no_handle if there is no free memory or no free handle.
+ **************************************************************************************************/
+heap_handle_t heap_handle_malloc(uint16_t bytes_num);
+
+
+/**********************************************************************************************//**
+ * @fn	void * heap_handle_lock(heap_handle_t handle)
+ *
+ * @brief	the function pins the relocatable memory and returns its address, the address is valid until the memory is unlocked.
+ *			The locks are counted, the memory can be moved again after the same number of heap_handle_unlock() calls.
+ *			The function must not be called from an interrupt, the memory may be moving at the time.
+ *
+ * @param		handle		handle of the memory.
+ * @returns	void *  memory address or NULL if the handle is not used.
+ **************************************************************************************************/
+void * heap_handle_lock(heap_handle_t handle);
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_handle_unlock(heap_handle_t handle)
+ *
+ * @brief	the function releases one lock of the relocatable memory, the address returned by heap_handle_lock()
+ *			must not be used after the last lock is released.
+ *
+ * @param		handle		handle of the memory.
+ **************************************************************************************************/
+void heap_handle_unlock(heap_handle_t handle);
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_handle_free(heap_handle_t handle)
+ *
+ * @brief	the function frees the relocatable memory and the handle, locked or not.
+ *
+ * @param		handle		handle of the memory.
+ **************************************************************************************************/
+void heap_handle_free(heap_handle_t handle);
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t heap_compact(void)
+ *
+ * @brief	the function compacts the whole heap, all unlocked relocatable memory is moved down as far as possible.
+ *			The heap is compacted in the idle time as well.
+ *
+ * @returns	uint8_t		number of memories moved.
+ **************************************************************************************************/
+uint8_t heap_compact(void);
+
+#endif
+
+
 #endif /* HEAP_H_ */
\ No newline at end of file
@@ -108,6 +108,30 @@ void __attribute__ ((naked)) __attribute__ ((section (".init3"))) __rtos_ports_s
 }
 
 
+#if BOARD_tickless_idle == TRUE
+/**********************************************************************************************//**
+ * @fn	uint32_t __rtos_get_nearest_deadline(void)
+ *
+ * @brief	the function returns the time in ticks to the nearest wake up of a sleeping task or timer expiry
+ *
+ * @returns	uint32_t.
+ **************************************************************************************************/
+
+static uint32_t __rtos_get_nearest_deadline(void)
+{
+	uint32_t deadline = __task_get_nearest_wakeup();
+#if BOARD_include_timers == TRUE
+	uint32_t timer_deadline = __timer_get_nearest_expiry();
+	
+	if(timer_deadline < deadline){
+		deadline = timer_deadline;
+	}
+#endif
+	return deadline;
+}
+#endif
+
+
 /**********************************************************************************************//**
  * @fn	void idle_task(void)
  *
@@ -117,11 +141,18 @@ void __attribute__ ((naked)) __attribute__ ((section (".init3"))) __rtos_ports_s
  *			any_irq_pending == TRUE -> run mode
  *
  *			any_peripheral		tasks_in_scheduler
- *				FALSE				FALSE				-> SLEEP_MODE_EXT_STANDBY
+ *				FALSE				FALSE				-> SLEEP_MODE_EXT_STANDBY (SLEEP_MODE_PWR_SAVE if BOARD_tickless_idle == TRUE)
  *				TRUE				FALSE				-> SLEEP_MODE_IDLE
  *				FALSE				TRUE				-> run mode
  *				TRUE				TRUE				-> run mode
  *
+ *			if BOARD_tickless_idle == TRUE the system timer period is stretched
+ *			up to the nearest deadline of sleeping tasks and timers
+ *
+ *			if there is relocatable memory, the heap is compacted before the CPU goes to sleep
+ *
+ *			if BOARD_heap_debug == TRUE the canaries of the heap allocations are checked in each pass
+ *
  **************************************************************************************************/
 
 TASK_my_task_t idle_task(void)
@@ -130,7 +161,15 @@ TASK_my_task_t idle_task(void)
 	uint8_t any_peripheral;				//check if more peripherals than just the system clock are enabled
 	uint8_t any_irq_pending;			//check if any interrupt has been reported.
 	
-	tasks_in_scheduler	= (task_get_number_of_running_tasks() > 1) ? TRUE : FALSE;
+#if BOARD_heap_debug == TRUE
+	__heap_debug_check();
+#endif
+#if BOARD_heap_number_of_handles > 0
+	if(__heap_compact_step() == TRUE){
+		rtos_back_jump();					//one relocatable memory is moved in each idle pass, the CPU sleeps once the heap is compact
+	}
+#endif
+	tasks_in_scheduler	= (task_ready_count() > 1) ? TRUE : FALSE;
 	any_peripheral		= (__rtos_peripherals == _BV(RTOS_peripheral_system_clock_timer)) ? FALSE : TRUE;
 	
 	cli();
@@ -144,13 +183,24 @@ TASK_my_task_t idle_task(void)
 			set_sleep_mode(SLEEP_MODE_IDLE);
 		
 		}else{
+#if BOARD_tickless_idle == TRUE
+			set_sleep_mode(SLEEP_MODE_PWR_SAVE);
+#else
 			set_sleep_mode(SLEEP_MODE_EXT_STANDBY);
+#endif
 		}
-
+#if BOARD_tickless_idle == TRUE
+		__timer_tickless_enter(__rtos_get_nearest_deadline());
+#endif
 		sleep_enable();
 		sei();
 		sleep_cpu();
 		sleep_disable();
+#if BOARD_tickless_idle == TRUE
+		cli();
+		__timer_tickless_exit();
+		sei();
+#endif
 		wdt_reset();
 		wdt_enable(BOARD_watch_dog_time);			//WATCHDOG ENABLE
 
@@ -333,6 +383,37 @@ __attribute__ ((noinline)) uint8_t rtos_irq_get(rtos_peripheral_irq_t irq)
 }
 
 
+/**********************************************************************************************//**
+ * @fn	rtos_peripheral_irq_register_t __rtos_irq_get_masked(rtos_peripheral_irq_register_t *mask)
+ *
+ * @brief	Used by the system to read and reset at once all reported interrupts given by the mask,
+ *			the other interrupts remain reported.
+ *
+ * @param	mask	pointer to the mask of interrupts to read.
+ *
+ * @returns	rtos_peripheral_irq_register_t	the reported interrupts from the mask.
+ **************************************************************************************************/
+
+rtos_peripheral_irq_register_t __rtos_irq_get_masked(rtos_peripheral_irq_register_t *mask)
+{
+	rtos_peripheral_irq_register_t irq_reg = 0;
+	uint8_t volatile *irQreg = (uint8_t volatile *)&__rtos_irq_reg;
+	uint8_t *irQmask = (uint8_t *)mask;
+	uint8_t irq_flag = rtos_cli();
+	
+	for(uint8_t i = 0; i < sizeof(rtos_peripheral_irq_register_t); i++){
+		uint8_t irQ = irQreg[i] & irQmask[i];
+		
+		if(irQ){
+			irQreg[i] &= ~irQ;
+			((uint8_t *)&irq_reg)[i] = irQ;
+		}
+	}
+	rtos_sei(irq_flag);
+	return irq_reg;
+}
+
+
 /**********************************************************************************************//**
  * @fn	void rtos_back_jump(void)
  *
@@ -415,6 +496,7 @@ __attribute__((naked)) void __rtos_scheduler(void)
 		sei();
 		
 		if(time != 0){
+			__rtos_system_time += time;
 			__timer_refresh_timers(time);
 			__task_refresh_delayed(time);
 		}
@@ -468,8 +550,12 @@ __attribute__((naked)) int main()
 	
 	task_init();
 	heap_init();
+#if BOARD_include_slab == TRUE
+	slab_init();
+#endif
 	__rtos_peripheral_init();
 	task_setup(&__idle_task, idle_task, NULL);
+	task_set_priority(TASK_priority_idle, &__idle_task);
 	task_start(&__idle_task);
 
 	if(rtos_initialize_avr_device != NULL){
@@ -1,21 +1,6 @@
 #ifndef __RTOS_H_						
 #define	__RTOS_H_
 
-#include "task.h"
-#include "heap.h"
-#include "semaphore.h"
-#include "timers.h"
-#include "board.h"
-#include "errCode.h"
-#include "event.h"
-
-#ifndef RUN_TESTS
-	#define RTOS_static	static
-#else
-	#include "test.h"
-	#define RTOS_static
-#endif
-
 #ifndef NULL
 #define	NULL	(void *)0x00
 #endif
@@ -45,6 +30,23 @@
 #endif
 
 
+#include "task.h"
+#include "heap.h"
+#include "semaphore.h"
+#include "timers.h"
+#include "board.h"
+#include "errCode.h"
+#include "event.h"
+#include "slab.h"
+
+#ifndef RUN_TESTS
+	#define RTOS_static	static
+#else
+	#include "test.h"
+	#define RTOS_static
+#endif
+
+
 #define RTOS_stack_overflow_tag_size		2
 #define RTOS_stack_overflow_tag				0xCA
 #define RTOS_err_out_of_dynamic_mem			0x80
@@ -84,6 +86,7 @@
 #endif
 
 void __rtos_wait_irq_val(rtos_peripheral_irq_t irq_nr);
+rtos_peripheral_irq_register_t __rtos_irq_get_masked(rtos_peripheral_irq_register_t *mask);
 
 
 
@@ -52,6 +52,7 @@ typedef enum{
 			
 
 #define rtos_peripheral_irq_register_t	uint64_t
+#define RTOS_peripheral_irq_number		(_IrqTIMER3_OVF + 1)
 
 typedef enum{
 				 _ADC = 0,
@@ -73,6 +74,10 @@ typedef enum{
 #define RTOS_peripheral_system_clock_OCRA					32
 #define RTOS_peripheral_system_clock_ticks_for_time(time_)	(( ((uint64_t)time_ * (uint64_t)RTOS_peripheral_system_clock_freq) / (RTOS_peripheral_system_clock_OCRA + 1) + 500) / 1000)
 
+#define RTOS_peripheral_system_clock_number_of_prescalers	7		//clk/1, clk/8, clk/32, clk/64, clk/128, clk/256, clk/1024
+#define RTOS_peripheral_system_clock_prescaler_shift(idx_)	((idx_) == 0 ? 0 : (idx_) == 1 ? 3 : (idx_) == 6 ? 10 : (idx_) + 3)
+#define RTOS_peripheral_system_clock_max_sleep_ticks		((256UL << RTOS_peripheral_system_clock_prescaler_shift(RTOS_peripheral_system_clock_number_of_prescalers - 1)) / (RTOS_peripheral_system_clock_OCRA + 1))
+
 #define RTOS_peripheral_system_clock_ticks_for_0x40000000ms		RTOS_peripheral_system_clock_ticks_for_time(0x40000000)
 #define RTOS_peripheral_system_clock_ticks_for_0x20000000ms		RTOS_peripheral_system_clock_ticks_for_time(0x20000000)
 #define RTOS_peripheral_system_clock_ticks_for_0x10000000ms		RTOS_peripheral_system_clock_ticks_for_time(0x10000000)
@@ -245,6 +250,68 @@ inline void __rtos_peripheral_init(void)
 #endif
 }
 
+
+/**********************************************************************************************//**
+ * @fn	void __rtos_peripheral_system_timer_setup(uint8_t prescaler, uint8_t ocr, uint8_t tcnt)
+ *
+ * @brief	the function reprograms the system timer, the global interrupt must be disabled.
+ *			the prescaler index selects clk/(1 << RTOS_peripheral_system_clock_prescaler_shift(prescaler))
+ *
+ * @param	prescaler	prescaler index
+ *			ocr			new compare value
+ *			tcnt		new counter value
+ **************************************************************************************************/
+inline void __rtos_peripheral_system_timer_setup(uint8_t prescaler, uint8_t ocr, uint8_t tcnt)
+{
+#if !defined(RUN_TESTS) && !defined(RUN_SIMULATOR)
+	TCCR2B	= prescaler + 1;
+	TCNT2	= tcnt;
+	OCR2A	= ocr;
+	GTCCR	= _BV(PSRASY);				//start counting from the beginning of the new prescaler period
+	while(ASSR & (_BV(TCN2UB) | _BV(OCR2AUB) | _BV(TCR2BUB)));
+#endif
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t __rtos_peripheral_system_timer_get_counter(void)
+ *
+ * @brief	the function returns the system timer counter, it can be used just after waking up
+ *			from the power save mode, the global interrupt must be disabled.
+ *
+ * @returns	uint8_t  counter value.
+ **************************************************************************************************/
+inline uint8_t __rtos_peripheral_system_timer_get_counter(void)
+{
+#if !defined(RUN_TESTS) && !defined(RUN_SIMULATOR)
+	OCR2B = 0x00;						//wait for one asynchronous clock cycle, otherwise TCNT2 can be read incorrectly after waking up
+	while(ASSR & _BV(OCR2BUB));
+	
+	return TCNT2;
+#else
+	return 0;
+#endif
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t __rtos_peripheral_system_timer_clear_irq(void)
+ *
+ * @brief	the function clears the pending system timer interrupt, the global interrupt must be disabled.
+ *
+ * @returns	uint8_t  TRUE if the interrupt was pending.
+ **************************************************************************************************/
+inline uint8_t __rtos_peripheral_system_timer_clear_irq(void)
+{
+#if !defined(RUN_TESTS)
+	if(TIFR2 & _BV(OCF2A)){
+		TIFR2 = _BV(OCF2A);
+		return TRUE;
+	}
+#endif
+	return FALSE;
+}
+
 #ifdef BOARD_AT_Package_TQFP
 inline uint8_t volatile *__rtos_getPORT(uint8_t pin_num)		
 {														
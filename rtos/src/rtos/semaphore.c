@@ -134,7 +134,7 @@ int8_t semaphore_signal(semaphore_t *sem)
 	if(sem == NULL)return -1;
 	
 	if(sem->head_pending_tasks_list != NULL){
-		task_handle_t *pending_task = task_list_pop_front(&sem->head_pending_tasks_list);
+		task_handle_t *pending_task = task_queue_pop_front(&sem->head_pending_tasks_list);
 
 		task_set_wait_for_semaphore(NULL, pending_task);
 		task_unfreeze(pending_task);
@@ -165,9 +165,14 @@ void semaphore_remove_from_pending_list(task_handle_t *task, semaphore_t *sem)
 {
 	if( (task == NULL) || (sem == NULL) )return;
 	if(task_get_wait_for_semaphore(task) == sem){
-		task_list_remove_by_item(&sem->head_pending_tasks_list, task);
+		task_queue_remove_by_item(&sem->head_pending_tasks_list, task);
 		task_set_wait_for_semaphore(NULL, task);
+		__task_timeout_remove(task);				//the task is not woken up by its timeout any more
 		task_freeze(SLEEP_INFINITE, task);
+		
+		if( (sem->type == THIS_IS_MUTEX) && (sem->owner != NULL) ){
+			__mutex_inherit_priority(sem->owner);		//the owner does not inherit the priority of the removed task any more
+		}
 	}
 }
 
@@ -183,12 +188,33 @@ void semaphore_remove_from_pending_list(task_handle_t *task, semaphore_t *sem)
   **************************************************************************************************/
 
 void __semaphore_wait(semaphore_t *sem)
+{
+	__semaphore_wait_timeout(sem, 0);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void __semaphore_wait_timeout(semaphore_t *sem, uint16_t time_ms)
+ *
+ * @brief	The function that decrements a semaphore counter, the task waits for the semaphore until the time runs out,
+ *			if the time is equal to 0, the task waits without a timeout.
+ *			Using this function without properly updating the task's program counter may result in unexpected program behavior.
+ *			Use the condWait_semaphore_wait_timeout() macro instead of this function.
+ *
+ * @param		sem			pointer to the semaphore.
+ *				time_ms		timeout in ms.
+  **************************************************************************************************/
+
+void __semaphore_wait_timeout(semaphore_t *sem, uint16_t time_ms)
 {
 	if(sem == NULL)return;
 
 	if(!semaphore_wait(sem)){
 		task_set_wait_for_semaphore(sem);
-		task_list_push_back((task_handle_t **)&sem->head_pending_tasks_list, task_freeze(WAIT_SEMA));
+		task_handle_t *task = task_freeze(WAIT_SEMA);
+		
+		task_queue_push_back((task_handle_t **)&sem->head_pending_tasks_list, task);
+		__task_timeout_start(task, time_ms);
 		rtos_back_jump();
 	}
 }
@@ -240,6 +266,24 @@ uint8_t _mutex_check_access(mutex_t *mutex, task_handle_t *task)
   **************************************************************************************************/
 
 void __mutex_lock(semaphore_t *mutex)
+{
+	__mutex_lock_timeout(mutex, 0);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void __mutex_lock_timeout(semaphore_t *mutex, uint16_t time_ms)
+ *
+ * @brief	the function that lock a mutex, the task waits for the mutex until the time runs out,
+ *			if the time is equal to 0, the task waits without a timeout.
+ *			Using this function without properly updating the task's program counter may result in unexpected program behavior.
+ *			Use the condWait_mutex_lock_timeout() macro instead of this function. 
+ *
+ * @param		mutex		pointer to the mutex.
+ *				time_ms		timeout in ms.
+  **************************************************************************************************/
+
+void __mutex_lock_timeout(semaphore_t *mutex, uint16_t time_ms)
 {
 	task_handle_t *task = task_this();
 	
@@ -254,7 +298,9 @@ void __mutex_lock(semaphore_t *mutex)
 	if(mutex->owner != NULL){
 		rtos_sei(irq);
 		task_set_wait_for_semaphore(mutex);
-		task_list_push_back((task_handle_t **)&mutex->head_pending_tasks_list, task_freeze(WAIT_SEMA));
+		task_queue_push_back((task_handle_t **)&mutex->head_pending_tasks_list, task_freeze(WAIT_SEMA));
+		__task_timeout_start(task, time_ms);
+		__mutex_raise_priority(mutex->owner, task->priority);
 		rtos_back_jump();
 	
 	}else{
@@ -270,7 +316,8 @@ void __mutex_lock(semaphore_t *mutex)
  * @fn	int8_t _mutex_unlock(mutex_t *mutex, task_handle_t *task=task_this())
  *
  * @brief	use this function to release access to a shared resource locked by a given task.
- *			the function wakes up the next waiting task.
+ *			the function wakes up the waiting task with the highest priority, the tasks with the same priority
+ *			get the mutex in the order they started to wait.
  *
  * @param		mutex	pointer to the mutex.
  *				task	pointer to the task, by default this function argument is null
@@ -313,8 +360,14 @@ int8_t _mutex_unlock(mutex_t *mutex, task_handle_t *task)
 	}
 	
 	if(mutex->head_pending_tasks_list != NULL){
-		task_handle_t *pending_task = task_list_pop_front(&mutex->head_pending_tasks_list);
-
+		task_handle_t *pending_task = mutex->head_pending_tasks_list;
+		
+		for(task_handle_t *next_task = pending_task->next_task; next_task != NULL; next_task = next_task->next_task){
+			if(next_task->priority > pending_task->priority){		//the first one of the highest priority, the same priorities in turn
+				pending_task = next_task;
+			}
+		}
+		task_queue_remove_by_item(&mutex->head_pending_tasks_list, pending_task);
 		task_set_wait_for_semaphore(NULL, pending_task);
 		task_unfreeze(pending_task);
 		mutex->next = task_get_first_mutex_from_list(pending_task);
@@ -326,10 +379,76 @@ int8_t _mutex_unlock(mutex_t *mutex, task_handle_t *task)
 	mutex->owner = new_owner;
 	rtos_sei(irq);
 	
+	__mutex_inherit_priority(task);				//the old owner gets back the priority of the mutexes it still owns
+	if(new_owner != NULL){
+		__mutex_inherit_priority(new_owner);	//the new owner inherits the priority of the remaining waiting tasks
+	}
 	return 0;
 }
 
 
+/**********************************************************************************************//**
+ * @fn	void __mutex_raise_priority(task_handle_t *task, uint8_t priority)
+ *
+ * @brief	Used by the system when a task starts to wait for the mutex owned by the given task.
+ *			The owner is raised to the priority of the waiting task if it runs lower, and so on along the chain
+ *			of the owners, without walking the waiting tasks. Only a lower priority needs __mutex_inherit_priority().
+ *
+ * @param		task		pointer to the owner of the mutex.
+ *				priority	priority of the waiting task.
+  **************************************************************************************************/
+
+void __mutex_raise_priority(task_handle_t *task, uint8_t priority)
+{
+	while( (task != NULL) && (task->priority < priority) ){		//the tasks waiting for each other stop at the raised one
+		__task_change_priority(task, priority);
+		
+		if( (task->state != WAIT_SEMA) || (task->sleep_sema == NULL) || (task->sleep_sema->type != THIS_IS_MUTEX) )return;
+		
+		task = task->sleep_sema->owner;
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void __mutex_inherit_priority(task_handle_t *task)
+ *
+ * @brief	Used by the system to set the priority the task is run with to the highest priority of its own
+ *			and of the tasks waiting for the mutexes it owns. If the task waits for a mutex itself,
+ *			the owner of that mutex is updated as well, and so on along the chain of the owners.
+ *			It walks all waiting tasks, so it is called only where the priority can drop: on the unlock,
+ *			the removal of a waiting task and task_set_priority().
+ *
+ * @param		task	pointer to the task.
+  **************************************************************************************************/
+
+void __mutex_inherit_priority(task_handle_t *task)
+{
+	task_handle_t *first_task = task;
+	
+	while(task != NULL){
+		uint8_t priority = task->base_priority;
+		
+		for(mutex_t *mutex = task->head_mutexes_list; mutex != NULL; mutex = mutex->next){
+			for(task_handle_t *pending_task = mutex->head_pending_tasks_list; pending_task != NULL; pending_task = pending_task->next_task){
+				if(pending_task->priority > priority){
+					priority = pending_task->priority;
+				}
+			}
+		}
+		if(priority == task->priority)return;
+		
+		__task_change_priority(task, priority);
+		
+		if( (task->state != WAIT_SEMA) || (task->sleep_sema == NULL) || (task->sleep_sema->type != THIS_IS_MUTEX) )return;
+		
+		task = task->sleep_sema->owner;
+		
+		if(task == first_task)return;			//the tasks wait for each other
+	}
+}
+
+
 
 
 
@@ -24,13 +24,17 @@ typedef struct semaphore{
 		uint8_t max_count;
 		uint8_t type;
 	};
-	struct task_handle	*head_pending_tasks_list;
+	struct task_handle	*head_pending_tasks_list;		//the queue of the waiting tasks, the prev_task of the first task is the last task
 	struct semaphore	*next;
 
 }semaphore_t, mutex_t;
 
 void __semaphore_wait(semaphore_t *sem);
+void __semaphore_wait_timeout(semaphore_t *sem, uint16_t time_ms);
 void __mutex_lock(mutex_t *mutex);
+void __mutex_lock_timeout(mutex_t *mutex, uint16_t time_ms);
+void __mutex_raise_priority(struct task_handle *task, uint8_t priority);
+void __mutex_inherit_priority(struct task_handle *task);
 
 
 /**********************************************************************************************//**
@@ -131,6 +135,26 @@ void semaphore_remove_from_pending_list(struct task_handle *task, semaphore_t *s
 			task_update_pc_addr_after_call(__semaphore_wait(sem))
 
 
+#if BOARD_task_timeouts == TRUE
+
+/**********************************************************************************************//**
+ * @fn	uint8_t condWait_semaphore_wait_timeout(semaphore_t *sem, uint16_t time_ms)
+ *
+ * @brief	The function that decrements a semaphore counter, used by task to access a shared resource.
+ *			Use this function if you want to freeze the task until the semaphore is obtained or the time runs out.
+ *			If the time is equal to 0, the task waits without a timeout.
+ *
+ * @param		sem			pointer to the semaphore.
+ *				time_ms		timeout in ms.
+ * @returns		uint8_t		TRUE - the semaphore has been obtained, FALSE - the time ran out.
+  **************************************************************************************************/
+#define condWait_semaphore_wait_timeout(sem, time_ms)({\
+			task_update_pc_addr_after_call(__semaphore_wait_timeout(sem, time_ms));\
+			(__task_timeout_expired() == FALSE);\
+		})
+#endif
+
+
 
 /**********************************************************************************************//**
  * @fn	void mutex_init(mutex_t *mutex)
@@ -198,6 +222,26 @@ uint8_t _mutex_check_access(mutex_t *mutex, struct task_handle *task);
 			task_update_pc_addr_after_call(__mutex_lock(mutex))
 
 
+#if BOARD_task_timeouts == TRUE
+
+/**********************************************************************************************//**
+ * @fn	uint8_t condWait_mutex_lock_timeout(mutex_t *mutex, uint16_t time_ms)
+ *
+ * @brief	the function that lock a mutex, used by task to access a shared resource.
+ *			Use this function if you want to freeze the task until the mutex is obtained or the time runs out.
+ *			If the time is equal to 0, the task waits without a timeout.
+ *
+ * @param		mutex		pointer to the mutex.
+ *				time_ms		timeout in ms.
+ * @returns		uint8_t		TRUE - the mutex has been locked, FALSE - the time ran out.
+  **************************************************************************************************/
+#define condWait_mutex_lock_timeout(mutex, time_ms)({\
+			task_update_pc_addr_after_call(__mutex_lock_timeout(mutex, time_ms));\
+			(__task_timeout_expired() == FALSE);\
+		})
+#endif
+
+
 /**********************************************************************************************//**
  * @fn	int8_t _mutex_unlock(mutex_t *mutex, task_handle_t *task=task_this())
  *
@@ -0,0 +1,261 @@
+/*
+ * slab.c
+ */
+#include <avr/io.h>
+#include <string.h>
+#include "rtos.h"
+
+#if BOARD_include_slab == TRUE
+
+#define SLAB_no_object		0xFF
+#define SLAB_no_class		0x00
+
+
+struct slab{
+	uint8_t			block_class[BOARD_heap_number_of_blocks];	//class number + 1 of the heap block, SLAB_no_class if the block is not used by the slab
+	uint8_t			block_used[BOARD_heap_number_of_blocks];	//number of objects in use
+	uint8_t			block_free[BOARD_heap_number_of_blocks];	//the first free object, the free objects are chained by their first byte
+	uint8_t			block_next[BOARD_heap_number_of_blocks];	//the list of the blocks with free objects
+	uint8_t			block_prev[BOARD_heap_number_of_blocks];
+	uint8_t			class_partial[SLAB_number_of_classes];		//the first block of the class with free objects
+	slab_stats_t	class_stats[SLAB_number_of_classes];
+};
+
+RTOS_static struct slab __slab;
+
+
+/**********************************************************************************************//**
+ * @fn	static void __slab_partial_push(uint8_t class_nr, uint8_t block_index)
+ *
+ * @brief	the function adds the block to the front of the list of class blocks with free objects
+ *
+ * @param		class_nr		class number.
+ * @param		block_index		index of the heap block.
+ **************************************************************************************************/
+
+static void __slab_partial_push(uint8_t class_nr, uint8_t block_index)
+{
+	uint8_t first = __slab.class_partial[class_nr];
+
+	__slab.block_prev[block_index] = HEAP_no_block;
+	__slab.block_next[block_index] = first;
+
+	if(first != HEAP_no_block){
+		__slab.block_prev[first] = block_index;
+	}
+	__slab.class_partial[class_nr] = block_index;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __slab_partial_remove(uint8_t class_nr, uint8_t block_index)
+ *
+ * @brief	the function removes the block from the list of class blocks with free objects
+ *
+ * @param		class_nr		class number.
+ * @param		block_index		index of the heap block.
+ **************************************************************************************************/
+
+static void __slab_partial_remove(uint8_t class_nr, uint8_t block_index)
+{
+	uint8_t next = __slab.block_next[block_index];
+	uint8_t prev = __slab.block_prev[block_index];
+
+	if(prev != HEAP_no_block){
+		__slab.block_next[prev] = next;
+
+	}else{
+		__slab.class_partial[class_nr] = next;
+	}
+	if(next != HEAP_no_block){
+		__slab.block_prev[next] = prev;
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static uint8_t __slab_get_class(uint16_t bytes_num)
+ *
+ * @brief	the function finds the smallest size class for the requested amount of bytes
+ *
+ * @param		bytes_num   number of bytes.
+ * @returns	uint8_t		class number or SLAB_number_of_classes if the request has to be passed to the heap.
+ **************************************************************************************************/
+
+static uint8_t __slab_get_class(uint16_t bytes_num)
+{
+	uint8_t class_nr = 0;
+
+	while( (class_nr < SLAB_number_of_classes) && (SLAB_class_size(class_nr) < bytes_num) ){
+		class_nr++;
+	}
+	if( (class_nr < SLAB_number_of_classes) && ((SLAB_class_size(class_nr) * 2) > BOARD_heap_single_block_size) ){
+		class_nr = SLAB_number_of_classes;		//not even two objects would fit in the heap block
+	}
+	return class_nr;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void slab_init(void)
+ *
+ * @brief	the function initialize the slab, the heap has to be initialized first
+ *
+ **************************************************************************************************/
+
+void slab_init(void)
+{
+	memset(__slab.block_class, SLAB_no_class, BOARD_heap_number_of_blocks);
+	memset(__slab.class_partial, HEAP_no_block, SLAB_number_of_classes);
+	memset(__slab.class_stats, 0x00, sizeof(__slab.class_stats));
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void * slab_malloc(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space from the smallest size class that fits (8, 16 or 32 bytes).
+ *			the objects are carved from heap blocks, a new heap block is taken only if the class has no free object.
+ *			The requests larger than the biggest class, or not smaller than half of the heap block, are passed to heap_malloc().
+ *			the function returns the address of available memory or, if it is missing, it returns null.
+ *
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL.
+ **************************************************************************************************/
+
+void * slab_malloc(uint16_t bytes_num)
+{
+	uint8_t class_nr, block_index, object_index, irq_flag;
+	uint8_t *object;
+	slab_stats_t *stats;
+
+	if(bytes_num == 0)return NULL;
+
+	class_nr = __slab_get_class(bytes_num);
+
+	if(class_nr == SLAB_number_of_classes){
+		return heap_malloc(bytes_num);
+	}
+	stats		= &__slab.class_stats[class_nr];
+	irq_flag	= rtos_cli();
+	block_index	= __slab.class_partial[class_nr];
+
+	if(block_index == HEAP_no_block){		//carve a new heap block into the objects
+		uint8_t objects_num = BOARD_heap_single_block_size / SLAB_class_size(class_nr);
+
+		rtos_sei(irq_flag);
+		object = heap_malloc_raw(BOARD_heap_single_block_size);		//the objects are cleared when they are allocated
+
+		if(object == NULL){
+			return NULL;
+		}
+		block_index = __heap_get_block_index(object);
+#if BOARD_heap_owner_tracking == TRUE
+		__heap_set_owner(object, NULL);			//the objects of the block belong to different tasks
+#endif
+
+		for(uint8_t i = 1; i < objects_num; i++, object += SLAB_class_size(class_nr)){
+			*object = i;
+		}
+		*object = SLAB_no_object;
+
+		irq_flag = rtos_cli();
+		__slab.block_class[block_index]	= class_nr + 1;
+		__slab.block_used[block_index]	= 0;
+		__slab.block_free[block_index]	= 0;
+		__slab_partial_push(class_nr, block_index);
+		stats->blocks++;
+		stats->free += objects_num;
+	}
+	object_index	= __slab.block_free[block_index];
+	object			= (uint8_t *)__heap_get_block_address(block_index) + (uint16_t)object_index * SLAB_class_size(class_nr);
+	__slab.block_free[block_index] = *object;
+	__slab.block_used[block_index]++;
+
+	if(__slab.block_free[block_index] == SLAB_no_object){		//the block is full
+		__slab_partial_remove(class_nr, block_index);
+	}
+	stats->free--;
+
+	if(++stats->used > stats->peak_used){
+		stats->peak_used = stats->used;
+	}
+	rtos_sei(irq_flag);
+
+	memset(object, 0x00, SLAB_class_size(class_nr));
+	return (void *)object;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void slab_free(void *memory_addr)
+ *
+ * @brief	the function frees the memory allocated by slab_malloc(), the memory allocated by heap_malloc() is passed to heap_free().
+ *			The heap block is given back to the heap when its last object is freed.
+ *
+ * @param		memory_addr   	memory address to free.
+ **************************************************************************************************/
+
+void slab_free(void *memory_addr)
+{
+	uint8_t block_index = __heap_get_block_index(memory_addr);
+	uint8_t class_nr, object_index, irq_flag;
+	uint8_t *block;
+	slab_stats_t *stats;
+
+	if( (block_index == HEAP_no_block) || (__slab.block_class[block_index] == SLAB_no_class) ){
+		heap_free(memory_addr);
+		return;
+	}
+	class_nr		= __slab.block_class[block_index] - 1;
+	stats			= &__slab.class_stats[class_nr];
+	block			= (uint8_t *)__heap_get_block_address(block_index);
+	object_index	= (uint8_t)(((uint16_t)((uint8_t *)memory_addr - block)) / SLAB_class_size(class_nr));
+	irq_flag		= rtos_cli();
+
+	if(__slab.block_free[block_index] == SLAB_no_object){		//the block has been full
+		__slab_partial_push(class_nr, block_index);
+	}
+	block[(uint16_t)object_index * SLAB_class_size(class_nr)] = __slab.block_free[block_index];
+	__slab.block_free[block_index] = object_index;
+	stats->used--;
+	stats->free++;
+
+	if(--__slab.block_used[block_index] == 0){		//the empty block is given back to the heap
+		__slab_partial_remove(class_nr, block_index);
+		__slab.block_class[block_index] = SLAB_no_class;
+		stats->blocks--;
+		stats->free -= BOARD_heap_single_block_size / SLAB_class_size(class_nr);
+		rtos_sei(irq_flag);
+		heap_free(block);
+		return;
+	}
+	rtos_sei(irq_flag);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t slab_get_stats(uint8_t class_size, slab_stats_t *stats)
+ *
+ * @brief	the function copies the statistics of the size class
+ *
+ * @param		class_size		size of the class objects in bytes (8, 16 or 32).
+ * @param		stats			pointer to the statistics to fill.
+ * @returns	uint8_t		TRUE - if the statistics have been copied, FALSE - if there is no such class.
+ **************************************************************************************************/
+
+uint8_t slab_get_stats(uint8_t class_size, slab_stats_t *stats)
+{
+	for(uint8_t class_nr = 0; class_nr < SLAB_number_of_classes; class_nr++){
+		if( (SLAB_class_size(class_nr) == class_size) && (stats != NULL) ){
+			uint8_t irq_flag = rtos_cli();
+
+			*stats = __slab.class_stats[class_nr];
+			rtos_sei(irq_flag);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+#endif
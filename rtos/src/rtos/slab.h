@@ -0,0 +1,82 @@
+/*
+ * slab.h
+ */
+
+
+#ifndef SLAB_H_
+#define SLAB_H_
+
+#if BOARD_include_slab == TRUE
+
+#if BOARD_heap_single_block_size > 0x7F8
+	#error "the slab can not be used with BOARD_heap_single_block_size greater than 2040"
+#endif
+
+#define SLAB_number_of_classes		3
+#define SLAB_class_size(class_nr)	(0x08 << (class_nr))		//8, 16, 32 bytes
+
+
+/**********************************************************************************************//**
+ * @struct	slab_stats_t
+ *
+ * @brief	the statistics of a single size class
+ **************************************************************************************************/
+
+typedef struct{
+	uint8_t		blocks;			//number of heap blocks carved into the objects of the class
+	uint16_t	used;			//number of objects in use
+	uint16_t	free;			//number of free objects in the blocks of the class
+	uint16_t	peak_used;		//the highest number of objects in use at the same time
+
+}slab_stats_t;
+
+
+/**********************************************************************************************//**
+ * @fn	void slab_init(void)
+ *
+ * @brief	the function initialize the slab, the heap has to be initialized first
+ *
+ **************************************************************************************************/
+void slab_init(void);
+
+
+/**********************************************************************************************//**
+ * @fn	void * slab_malloc(uint16_t bytes_num)
+ *
+ * @brief	the function allocates the requested amount of space from the smallest size class that fits (8, 16 or 32 bytes).
+ *			the objects are carved from heap blocks, a new heap block is taken only if the class has no free object.
+ *			The requests larger than the biggest class, or not smaller than half of the heap block, are passed to heap_malloc().
+ *			the function returns the address of available memory or, if it is missing, it returns null.
+ *
+ * @param		bytes_num   number of bytes.
+ * @returns	void *  memory address or NULL.
+ **************************************************************************************************/
+void * slab_malloc(uint16_t bytes_num);
+
+
+/**********************************************************************************************//**
+ * @fn	void slab_free(void *memory_addr)
+ *
+ * @brief	the function frees the memory allocated by slab_malloc(), the memory allocated by heap_malloc() is passed to heap_free().
+ *			The heap block is given back to the heap when its last object is freed.
+ *
+ * @param		memory_addr   	memory address to free.
+ **************************************************************************************************/
+void slab_free(void *memory_addr);
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t slab_get_stats(uint8_t class_size, slab_stats_t *stats)
+ *
+ * @brief	the function copies the statistics of the size class
+ *
+ * @param		class_size		size of the class objects in bytes (8, 16 or 32).
+ * @param		stats			pointer to the statistics to fill.
+ * @returns	uint8_t		TRUE - if the statistics have been copied, FALSE - if there is no such class.
+ **************************************************************************************************/
+uint8_t slab_get_stats(uint8_t class_size, slab_stats_t *stats);
+
+
+#endif /* BOARD_include_slab */
+
+#endif /* SLAB_H_ */
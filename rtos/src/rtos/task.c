@@ -11,8 +11,262 @@
 
 
 RTOS_static	volatile 	task_handle_t *volatile	__task_sleeping_g;
-RTOS_static	volatile 	task_handle_t *volatile	__task_interrupted_g;
+#if BOARD_task_timeouts == TRUE
+RTOS_static	volatile 	task_handle_t *volatile	__task_timeout_g;								//tasks waiting for something with a timeout
+#endif
+RTOS_static	volatile 	task_handle_t *volatile	__task_irq_waiters[RTOS_peripheral_irq_number];		//tasks waiting for a given interrupt
+RTOS_static				rtos_peripheral_irq_register_t	__task_irq_waiting_mask;						//bit n is set if any task is waiting for the interrupt n
 RTOS_static volatile	task_handle_t *volatile	__task_ready_g __attribute__((section(".noinit")));
+RTOS_static volatile	task_handle_t *volatile	__task_ready_lvl[BOARD_task_number_of_priorities];	//last task run on a given priority level
+RTOS_static volatile	uint8_t					__task_ready_map;									//bit n is set if level n has any task ready
+RTOS_static volatile	uint8_t					__task_ready_num;									//number of tasks in the lists of all priority levels
+
+
+/**********************************************************************************************//**
+ * @fn	static uint8_t __task_ready_highest_priority(void)
+ *
+ * @brief	the function returns the highest priority level with at least one ready task,
+ *			__task_ready_map must not be equal to 0.
+ *
+ * @returns	uint8_t  priority level.
+ **************************************************************************************************/
+
+static uint8_t __task_ready_highest_priority(void)
+{
+	uint8_t map = __task_ready_map;
+	uint8_t priority = 0;
+	
+	if(map & 0xF0){
+		map >>= 4;
+		priority = 4;
+	}
+	if(map & 0x0C){
+		map >>= 2;
+		priority += 2;
+	}
+	if(map & 0x02){
+		priority++;
+	}
+	return priority;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __task_sleeping_insert(task_handle_t *task, uint16_t sleep_time)
+ *
+ * @brief	the function adds a task to the list of sleeping tasks. The list is sorted by the wake up time
+ *			and each task stores its sleep time relative to the previous task in the list (delta list),
+ *			so only the first task has to be refreshed.
+ *
+ * @param	task		task to add.
+ *			sleep_time	sleep time in ticks.
+ **************************************************************************************************/
+
+static void __task_sleeping_insert(task_handle_t *task, uint16_t sleep_time)
+{
+	task_handle_t **list_task = (task_handle_t **)&__task_sleeping_g;
+	task_handle_t *prev = NULL;
+	
+	while( (*list_task != NULL) && ((*list_task)->sleep_time <= sleep_time) ){
+		sleep_time	-= (*list_task)->sleep_time;
+		prev		= *list_task;
+		list_task	= &((*list_task)->next_task);
+	}
+	task->sleep_time	= sleep_time;
+	task->prev_task		= prev;
+	task->next_task		= *list_task;
+	
+	if(*list_task != NULL){
+		(*list_task)->sleep_time	-= sleep_time;
+		(*list_task)->prev_task		= task;
+	}
+	*list_task = task;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __task_sleeping_remove(task_handle_t *task)
+ *
+ * @brief	the function removes a task from the list of sleeping tasks,
+ *			the rest of its sleep time is passed to the next task in the list.
+ *
+ * @param	task		task to remove.
+ **************************************************************************************************/
+
+static void __task_sleeping_remove(task_handle_t *task)
+{
+	if(task->next_task != NULL){
+		(task->next_task)->sleep_time += task->sleep_time;
+	}
+	task->sleep_time = 0;
+	task_list_remove_by_item((task_handle_t **)&__task_sleeping_g, task);
+}
+
+
+#if BOARD_task_timeouts == TRUE
+
+/**********************************************************************************************//**
+ * @fn	static void __task_timeout_insert(task_handle_t *task, uint16_t time)
+ *
+ * @brief	the function adds a task to the list of timeouts. It is a delta list like the list of sleeping tasks,
+ *			but it is linked by the timeout links, so the task stays in the list of the object it is waiting for.
+ *
+ * @param	task		task to add.
+ *			time		timeout in ticks.
+ **************************************************************************************************/
+
+static void __task_timeout_insert(task_handle_t *task, uint16_t time)
+{
+	task_handle_t **list_task = (task_handle_t **)&__task_timeout_g;
+	task_handle_t *prev = NULL;
+	
+	while( (*list_task != NULL) && ((*list_task)->timeout.time <= time) ){
+		time		-= (*list_task)->timeout.time;
+		prev		= *list_task;
+		list_task	= &((*list_task)->timeout.next_task);
+	}
+	task->timeout.time		= time;
+	task->timeout.prev_task	= prev;
+	task->timeout.next_task	= *list_task;
+	
+	if(*list_task != NULL){
+		(*list_task)->timeout.time		-= time;
+		(*list_task)->timeout.prev_task	= task;
+	}
+	*list_task = task;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void __task_timeout_remove(task_handle_t *task)
+ *
+ * @brief	Used by the system to remove a task from the list of timeouts in constant time,
+ *			the rest of its time is passed to the next task in the list. Nothing is done if the task is not in the list.
+ *
+ * @param	task		task to remove.
+ **************************************************************************************************/
+
+void __task_timeout_remove(task_handle_t *task)
+{
+	task_handle_t *next = task->timeout.next_task;
+	task_handle_t *prev = task->timeout.prev_task;
+	
+	if( (prev == NULL) && (task != __task_timeout_g) )return;
+	
+	if(next != NULL){
+		next->timeout.time		+= task->timeout.time;
+		next->timeout.prev_task	= prev;
+	}
+	if(prev != NULL){
+		prev->timeout.next_task	= next;
+	}else{
+		__task_timeout_g		= next;
+	}
+	task->timeout.next_task	= NULL;
+	task->timeout.prev_task	= NULL;
+	task->timeout.time		= 0;
+}
+
+#endif
+
+
+/**********************************************************************************************//**
+ * @fn	static void __task_irq_waiter_remove(task_handle_t *task)
+ *
+ * @brief	the function removes a task from the list of tasks waiting for its interrupt,
+ *			the interrupt is no longer checked if no other task is waiting for it.
+ *
+ * @param	task		task to remove.
+ **************************************************************************************************/
+
+static void __task_irq_waiter_remove(task_handle_t *task)
+{
+	uint8_t irq_nr = task->sleep_irq_num;
+	
+	task_list_remove_by_item((task_handle_t **)&__task_irq_waiters[irq_nr], task);
+	
+	if(__task_irq_waiters[irq_nr] == NULL){
+		((uint8_t *)&__task_irq_waiting_mask)[irq_nr >> 3] &= ~_BV(irq_nr & 0x07);
+	}
+	task->sleep_irq_num = 0;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static uint8_t __task_is_ready(task_handle_t *task)
+ *
+ * @brief	the function checks if a task is attached to the list of currently working tasks.
+ *
+ * @param	task	task to check.
+ *
+ * @returns	uint8_t		TRUE - the task is in the list of currently working tasks
+ *						FALSE - the task is not in the list of currently working tasks
+ **************************************************************************************************/
+
+static inline uint8_t __task_is_ready(task_handle_t *task)
+{
+	return ( ((task->state == READY) || (task->state == RUNNING)) && (task->next_task != NULL) ) ? TRUE : FALSE;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __task_ready_insert(task_handle_t *task, uint8_t at_front)
+ *
+ * @brief	the function adds a task to the circular list of its priority level.
+ *
+ * @param	task		task to add.
+ *			at_front	TRUE - the task will be run as the next one from its level
+ *						FALSE - the task will be run as the last one from its level
+ **************************************************************************************************/
+
+static void __task_ready_insert(task_handle_t *task, uint8_t at_front)
+{
+	task_handle_t *list_task = (task_handle_t *)__task_ready_lvl[task->priority];
+	
+	if(list_task == NULL){	//if there is only one task, it must point to itself as prev_task/next_task
+		task->prev_task						= task;
+		task->next_task						= task;
+		__task_ready_lvl[task->priority]	= task;
+		__task_ready_map				   |= _BV(task->priority);
+		
+	}else{
+		if(at_front == FALSE){
+			list_task = list_task->prev_task;
+		}
+		task->prev_task					= list_task;
+		task->next_task					= list_task->next_task;
+		(list_task->next_task)->prev_task	= task;
+		list_task->next_task			= task;
+	}
+	__task_ready_num++;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __task_ready_remove(task_handle_t *task)
+ *
+ * @brief	the function removes a task from the circular list of its priority level.
+ *
+ * @param	task		task to remove.
+ **************************************************************************************************/
+
+static void __task_ready_remove(task_handle_t *task)
+{
+	if(task->next_task == task){
+		__task_ready_lvl[task->priority]	= NULL;
+		__task_ready_map				   &= ~_BV(task->priority);
+		
+	}else{
+		if(__task_ready_lvl[task->priority] == task){
+			__task_ready_lvl[task->priority] = task->prev_task;
+		}
+		(task->prev_task)->next_task	= task->next_task;
+		(task->next_task)->prev_task	= task->prev_task;
+	}
+	task->next_task = NULL;
+	task->prev_task = NULL;
+	__task_ready_num--;
+}
 
 
 /**********************************************************************************************//**
@@ -136,7 +390,8 @@ task_handle_t *task_list_pop_back(task_handle_t **head)
 /**********************************************************************************************//**
  * @fn	void task_list_remove_by_item(task_handle_t **head, task_handle_t *item)
  *
- * @brief	function removes a specific item from a doubly linked list.
+ * @brief	function removes a specific item from a doubly linked list in constant time,
+ *			the item is unlinked through its prev_task, only the first item of the list has no prev_task.
  *
  * @param		head   	pointer to pointer to the top of the lists.
  *				item	item to remove
@@ -147,14 +402,101 @@ void task_list_remove_by_item(task_handle_t **head, task_handle_t *item)
 {	
 	if( (head == NULL) || (item == NULL) )return;
 	
-	while(*head != item){
-		head = &((*head)->next_task);
-		if(*head == NULL)return;
+	if(item->prev_task != NULL){
+		(item->prev_task)->next_task = item->next_task;
+		
+	}else if(*head == item){
+		*head = item->next_task;
+		
+	}else{
+		return;					//the item is not in any list
 	}
+	if(item->next_task != NULL)
+		(item->next_task)->prev_task = item->prev_task;
+	item->next_task = NULL;
+	item->prev_task = NULL;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void task_queue_push_back(task_handle_t **head, task_handle_t *new_task)
+ *
+ * @brief	the function adds a new item to the end of the queue in constant time.
+ *			The queue is a doubly linked list whose first item points to the last one as its prev_task,
+ *			the next_task of the last item is NULL, so the queue is walked from the head like the list.
+ *
+ * @param		head   		pointer to pointer to the top of the queue.
+ * @param		new_task   	new item to add to the queue.
+ **************************************************************************************************/
+
+void task_queue_push_back(task_handle_t **head, task_handle_t *new_task)
+{
+	if( (head == NULL) || (new_task == NULL) )return;
+	
+	new_task->next_task = NULL;
+	
+	if(*head == NULL){
+		new_task->prev_task	= new_task;
+		*head				= new_task;
+		return;
+	}
+	new_task->prev_task				= (*head)->prev_task;
+	((*head)->prev_task)->next_task	= new_task;
+	(*head)->prev_task				= new_task;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	task_handle_t *task_queue_pop_front(task_handle_t **head)
+ *
+ * @brief	the function removes an item from the beginning of the queue in constant time.
+ *
+ * @param		head   	pointer to pointer to the top of the queue.
+ *
+ * @returns	task_handle_t *  address of the deleted item or NULL.
+ **************************************************************************************************/
+
+task_handle_t *task_queue_pop_front(task_handle_t **head)
+{
+	task_handle_t *task;
+	
+	if( (head == NULL) || (*head == NULL) )return NULL;
+	
+	task = *head;
+	*head = task->next_task;
+	if(*head != NULL)
+		(*head)->prev_task = task->prev_task;			//the new head takes over the link to the last item
+	task->next_task = NULL;
+	task->prev_task = NULL;
+	
+	return task;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void task_queue_remove_by_item(task_handle_t **head, task_handle_t *item)
+ *
+ * @brief	the function removes a specific item from the queue in constant time, the item has to be in the queue.
+ *
+ * @param		head   	pointer to pointer to the top of the queue.
+ *				item	item to remove
+ *
+ **************************************************************************************************/
+
+void task_queue_remove_by_item(task_handle_t **head, task_handle_t *item)
+{
+	if( (head == NULL) || (*head == NULL) || (item == NULL) || (item->prev_task == NULL) )return;
+	
+	if(item == *head){
+		task_queue_pop_front(head);
+		return;
+	}
+	(item->prev_task)->next_task = item->next_task;
 	
-	*head = item->next_task;
 	if(item->next_task != NULL)
 		(item->next_task)->prev_task = item->prev_task;
+	else
+		(*head)->prev_task = item->prev_task;			//the last item is removed
 	item->next_task = NULL;
 	item->prev_task = NULL;
 }
@@ -170,9 +512,22 @@ void task_list_remove_by_item(task_handle_t **head, task_handle_t *item)
 
 void task_init(void)
 {
-	__task_interrupted_g = NULL;
+	__task_irq_waiting_mask = 0;
+	
+	for(uint8_t irq_nr = 0; irq_nr < RTOS_peripheral_irq_number; irq_nr++){
+		__task_irq_waiters[irq_nr] = NULL;
+	}
 	__task_ready_g = NULL;
 	__task_sleeping_g = NULL;
+#if BOARD_task_timeouts == TRUE
+	__task_timeout_g = NULL;
+#endif
+	__task_ready_map = 0;
+	__task_ready_num = 0;
+	
+	for(uint8_t priority = 0; priority < BOARD_task_number_of_priorities; priority++){
+		__task_ready_lvl[priority] = NULL;
+	}
 }
 
 
@@ -265,25 +620,102 @@ struct semaphore *_task_get_first_mutex_from_list(task_handle_t *task)
 }
 
 
+/**********************************************************************************************//**
+ * @fn	uint8_t task_ready_count(void)
+ *
+ * @brief	the function returns the number of currently running tasks in constant time,
+ *			the number is updated whenever a task is added to or removed from the lists of the priority levels.
+ *
+ * @returns	uint8_t  number of tasks.
+ **************************************************************************************************/
+
+uint8_t task_ready_count(void)
+{
+	return __task_ready_num;
+}
+
+
 /**********************************************************************************************//**
  * @fn	uint8_t task_get_number_of_running_tasks(void)
  *
- * @brief	the function returns the number of currently running tasks. 
+ * @brief	the function returns the number of currently running tasks, the same as task_ready_count(). 
  *
  * @returns	uint8_t  number of tasks .
  **************************************************************************************************/
 
 uint8_t task_get_number_of_running_tasks(void)
 {
-	uint8_t cnt;
-	
-	if(__task_ready_g == NULL)return 0;
-	
-	cnt = 1;
+	return task_ready_count();
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void _task_set_priority(uint8_t priority, task_handle_t *task=task_this())
+ *
+ * @brief	the function sets the priority of a given task. The scheduler always runs
+ *			the tasks with the highest priority first, tasks with the same priority are run in turn.
+ *			Values above TASK_priority_highest are limited to TASK_priority_highest.
+ *
+ * @param	priority	new priority, from TASK_priority_idle to TASK_priority_highest
+ *			task   		pointer to the task, by default this function argument is null
+ *						it means call this function for currently running task
+ **************************************************************************************************/
+
+__attribute__ ((noinline)) void _task_set_priority(uint8_t priority, task_handle_t *task)
+{
+	if(task == NULL){
+		if(__task_ready_g == NULL)return;
+		task = (task_handle_t *)__task_ready_g;
+	}
+	if(priority > TASK_priority_highest){
+		priority = TASK_priority_highest;
+	}
+	task->base_priority = priority;
+	__mutex_inherit_priority(task);		//the priority inherited through the owned mutexes is kept
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void __task_change_priority(task_handle_t *task, uint8_t priority)
+ *
+ * @brief	Used by the system to change the priority the task is run with, the ready task is moved
+ *			to the list of the new priority level. The priority set by the user is not changed.
+ *
+ * @param	task   		pointer to the task.
+ *			priority	new priority.
+ **************************************************************************************************/
+
+void __task_change_priority(task_handle_t *task, uint8_t priority)
+{
+	if(task->priority == priority)return;
 	
-	for(task_handle_t *task = (task_handle_t *)__task_ready_g; task->next_task != __task_ready_g; cnt++, task = task->next_task);
+	if(__task_is_ready(task)){	//move the task to the list of the new priority level
+		__task_ready_remove(task);
+		task->priority = priority;
+		__task_ready_insert(task, FALSE);
+		
+	}else{
+		task->priority = priority;
+	}
+}
+
 
-	return cnt;
+/**********************************************************************************************//**
+ * @fn	uint8_t _task_get_priority(task_handle_t *task=task_this())
+ *
+ * @brief	the function returns the priority of a given task. 
+ *
+ * @param	task   	pointer to the task, by default this function argument is null
+ *					it means call this function for currently running task
+ *
+ * @returns	uint8_t  task priority.
+ **************************************************************************************************/
+
+uint8_t _task_get_priority(task_handle_t *task)
+{
+	if(task == NULL)task = (task_handle_t *)__task_ready_g;
+	
+	return task == NULL ? TASK_priority_idle : task->priority;
 }
 
 
@@ -374,16 +806,22 @@ __attribute__ ((noinline)) task_handle_t *task_this(void)
 /**********************************************************************************************//**
  * @fn	void __task_switch(void)
  *
- * @brief	this function allows you to switch the currently running task to the next task on the list
+ * @brief	this function allows you to switch the currently running task to the next task
+ *			from the highest priority level which has any task ready to run
  *
  **************************************************************************************************/
 
 void __task_switch(void)
 {
-	if(__task_ready_g){
-		__task_ready_g->state				= READY;
-		__task_ready_g						= __task_ready_g->next_task;
-		__task_ready_g->state				= RUNNING;
+	if(__task_ready_map){
+		uint8_t priority = __task_ready_highest_priority();
+		
+		if( (__task_ready_g != NULL) && (__task_ready_g->state == RUNNING) ){
+			__task_ready_g->state		= READY;
+		}
+		__task_ready_lvl[priority]		= __task_ready_lvl[priority]->next_task;
+		__task_ready_g					= __task_ready_lvl[priority];
+		__task_ready_g->state			= RUNNING;
 	}
 }
 
@@ -409,7 +847,8 @@ __attribute__ ((noinline)) task_dynamic_handle_t *task_dynamic_this(void)
 /**********************************************************************************************//**
  * @fn	void task_setup(task_rtos_handle_t *task, void (*task_code_addr)(void), void (*destructor_call_addr)(task_rtos_handle_t *)=NULL)
  *
- * @brief	the function will initialize a new task
+ * @brief	the function will initialize a new task, the task priority is set to TASK_priority_default
+ *			and the task owns no mutex. Set another priority with task_set_priority() after the setup.
  *
  * @param	task					task address
  *			task_code_addr			task program address.
@@ -421,6 +860,9 @@ __attribute__ ((noinline)) void _task_setup(task_handle_t *task, void (*task_cod
 {
 	if( (task == NULL) || (task_code_addr == NULL) )return;
 	
+	task->head_mutexes_list	= NULL;
+	task->base_priority		= TASK_priority_default;
+	task->priority			= TASK_priority_default;		//the stopped task is in no ready list, nothing to move
 	((uint16_t *)task)[1]	= (uint16_t)task_code_addr;
 	task->PC 				= (uint16_t)task_code_addr;
 	task->state				= STOPPED;
@@ -434,7 +876,8 @@ __attribute__ ((noinline)) void _task_setup(task_handle_t *task, void (*task_cod
  * @brief	the function will create a new task in dynamic memory. For task call if there is no available memory,
  *			it will add the current task to the waiting queue.
  *
- * @param	heap_malloc_f			malloc function pointer different for task and function call
+ * @param	heap_malloc_f			malloc function pointer different for task and function call, the memory has to be cleared
+ *									because the dynamic variables of the task start from zero
  *			task_code_addr			task program address.
 			destructor_call_addr	task destructor program address, by default this function argument is null
  *									it means no destructor function
@@ -450,7 +893,13 @@ __attribute__ ((noinline)) void * _task_new(void *(*heap_malloc_f)(uint16_t), vo
 	task_handle_t *NewT = heap_malloc_f(sizeof(task_handle_t));
 
 	if(NewT){
+#if BOARD_heap_debug == TRUE
+		__heap_debug_disarm(NewT);				//the canary would be in the dynamic variables
+#endif
 		task_setup(NewT, task_code_addr, destructor_call_addr);
+#if BOARD_heap_owner_tracking == TRUE
+		__heap_set_owner(NewT, NewT);			//the task handle is freed by task_erase only if it is permanent
+#endif
 	}	
 	return NewT;
 }
@@ -476,24 +925,19 @@ __attribute__ ((noinline)) task_handle_t *_task_freeze(task_state_t new_task_sta
 			return NULL;
 		task = (task_handle_t *)__task_ready_g;
 	}
-	if(task != __task_ready_g){
-		for(task_handle_t *list_task = (__task_ready_g ? __task_ready_g->next_task : NULL); list_task != task; list_task = list_task->next_task){
-			if(list_task == __task_ready_g){										//there is no such task in the currently running task list
-				if( (task->next_task == NULL) && (task->prev_task == NULL) ){		//the state can only be changed if the task is not attached to any task list
-					task->state = new_task_state == (new_task_state == RUNNING) || (new_task_state == READY) ? SLEEP_INFINITE : new_task_state;
-				}
-				return task;
-			}
+	if(__task_is_ready(task)){
+		__task_ready_remove(task);
+		
+	}else if(task != __task_ready_g){											//there is no such task in the currently running task list
+		if( (task->next_task == NULL) && (task->prev_task == NULL) ){		//the state can only be changed if the task is not attached to any task list
+			task->state = (new_task_state == RUNNING) || (new_task_state == READY) ? SLEEP_INFINITE : new_task_state;
 		}
- 
-	}else{
-		__task_ready_g = (task->prev_task == task) ? NULL : task->prev_task;	//if prev_task/next_task is equal to task it means that this is the only running task
+		return task;
 	}
 	
-	(task->prev_task)->next_task	= task->next_task;
-	(task->next_task)->prev_task	= task->prev_task;
-	task->next_task					= NULL;
-	task->prev_task					= NULL;
+	if(task == __task_ready_g){		//the current task is taken over by the last task run on the highest priority level
+		__task_ready_g = __task_ready_map ? __task_ready_lvl[__task_ready_highest_priority()] : NULL;
+	}
 	task->state    					= (new_task_state == RUNNING) || (new_task_state == READY) ? SLEEP_INFINITE : new_task_state;
 	return task;
 }
@@ -512,39 +956,29 @@ __attribute__ ((noinline)) task_handle_t *_task_freeze(task_state_t new_task_sta
 
 __attribute__ ((noinline))void task_unfreeze(task_handle_t *wakeup_task)
 {
-	task_handle_t *task;
+	uint8_t at_front = FALSE;
 	
 	if( (wakeup_task == NULL) ||
 		(wakeup_task->code_addr == 0) ||
-		(wakeup_task->PC == 0) )
+		(wakeup_task->PC == 0) ||
+		(__task_is_ready(wakeup_task)) )
 	{
 		return;		
 	}
 	
 	if(wakeup_task->state == SLEEP_TIMED){
-		wakeup_task->sleep_time = 0;
-		task_list_remove_by_item((task_handle_t **)&__task_sleeping_g, wakeup_task);
-		task = (task_handle_t *)__task_ready_g;
+		__task_sleeping_remove(wakeup_task);
+		at_front = TRUE;
 	
 	}else if(wakeup_task->state == INTERRUPT){
-		wakeup_task->sleep_irq_num = 0;
-		task_list_remove_by_item((task_handle_t **)&__task_interrupted_g, wakeup_task);
-		task = (task_handle_t *)__task_ready_g;
-		
-	}else{
-		task = (task_handle_t *)__task_ready_g->prev_task;
+		__task_irq_waiter_remove(wakeup_task);
+		at_front = TRUE;
 	}
+	__task_timeout_remove(wakeup_task);		//the task got what it was waiting for before the time ran out
+	__task_ready_insert(wakeup_task, at_front);
 
-	if(__task_ready_g == NULL){	//if there is only one task, it must point to itself as prev_task/next_task
-		wakeup_task->prev_task	= wakeup_task;
-		wakeup_task->next_task	= wakeup_task;
-		__task_ready_g		= wakeup_task;
-	
-	}else{
-		wakeup_task->prev_task			= task;
-		wakeup_task->next_task			= task->next_task;
-		(task->next_task)->prev_task	= wakeup_task;
-		task->next_task					= wakeup_task;
+	if(__task_ready_g == NULL){
+		__task_ready_g = wakeup_task;
 	}
 	wakeup_task->state = READY;
 }
@@ -559,13 +993,31 @@ __attribute__ ((noinline))void task_unfreeze(task_handle_t *wakeup_task)
  **************************************************************************************************/
 
 __attribute__ ((noinline)) void __task_wait_for_irq(rtos_peripheral_irq_t irq_nr)
+{
+	__task_wait_for_irq_timeout(irq_nr, 0);
+}
+
+
+/**********************************************************************************************//**
+ * @fn void __task_wait_for_irq_timeout(rtos_peripheral_irq_t irq_nr, uint16_t time_ms)
+ *
+ * @brief	This function will suspend the currently running task until the given irq_nr is reported
+ *			or the time runs out, if the time is equal to 0, the task waits without a timeout.
+ *
+ * @param	irq_nr		irq number to check.
+ *			time_ms		timeout in ms.
+ **************************************************************************************************/
+
+__attribute__ ((noinline)) void __task_wait_for_irq_timeout(rtos_peripheral_irq_t irq_nr, uint16_t time_ms)
 {
 	task_handle_t *task = (task_handle_t *)__task_ready_g;
 	
-	if(task != NULL){	
+	if( (task != NULL) && (irq_nr < RTOS_peripheral_irq_number) ){	
 		task->sleep_irq_num = irq_nr;
 		task_freeze(INTERRUPT, task);
-		task_list_push_front((task_handle_t **)&__task_interrupted_g, task);
+		task_list_push_front((task_handle_t **)&__task_irq_waiters[irq_nr], task);
+		((uint8_t *)&__task_irq_waiting_mask)[irq_nr >> 3] |= _BV(irq_nr & 0x07);
+		__task_timeout_start(task, time_ms);
 	}
 	rtos_back_jump();
 }
@@ -574,22 +1026,34 @@ __attribute__ ((noinline)) void __task_wait_for_irq(rtos_peripheral_irq_t irq_nr
 /**********************************************************************************************//**
  * @fn	void __task_refresh_interrupted(void)
  *
- * @brief	Used by the system to refresh the list of tasks waiting for an interrupt request.
+ * @brief	Used by the system to wake up the tasks waiting for the reported interrupts.
+ *			Only the interrupts some task is waiting for are read and reset,
+ *			the tasks are found directly in the table of waiters.
  *
  **************************************************************************************************/
 
 void __task_refresh_interrupted(void)
 {
-	task_handle_t *irq_wait_task = (task_handle_t *)__task_interrupted_g;
+	if(__task_irq_waiting_mask == 0)return;
 	
-	while(irq_wait_task != NULL)
-	{
-		task_handle_t *next_irq_wait_task = irq_wait_task->next_task;
-
-		if(rtos_irq_get(irq_wait_task->sleep_irq_num)){
-			task_unfreeze(irq_wait_task);	
+	rtos_peripheral_irq_register_t irq_reg = __rtos_irq_get_masked(&__task_irq_waiting_mask);
+	
+	for(uint8_t i = 0; (i < sizeof(rtos_peripheral_irq_register_t)) && irq_reg; i++){
+		uint8_t irQ = ((uint8_t *)&irq_reg)[i];
+		
+		for(uint8_t irq_nr = i << 3; irQ; irQ >>= 1, irq_nr++){
+			if(irQ & 0x01){
+				task_handle_t *irq_wait_task = (task_handle_t *)__task_irq_waiters[irq_nr];
+				
+				while(irq_wait_task != NULL){	//all tasks waiting for this interrupt are woken up
+					task_handle_t *next_irq_wait_task = irq_wait_task->next_task;
+					
+					task_unfreeze(irq_wait_task);
+					irq_wait_task = next_irq_wait_task;
+				}
+			}
 		}
-		irq_wait_task = next_irq_wait_task;
+		((uint8_t *)&irq_reg)[i] = 0;
 	}
 }
 
@@ -605,7 +1069,28 @@ void __task_refresh_interrupted(void)
 
 uint8_t task_check_if_any_is_waiting_for_irq(void)
 {
-	return __task_interrupted_g != NULL ? TRUE : FALSE;
+	return __task_irq_waiting_mask != 0 ? TRUE : FALSE;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static uint16_t __task_ticks_from_now(uint16_t time_ms)
+ *
+ * @brief	the function converts the time from now to the number of ticks from the last refresh of the sleeping tasks.
+ *
+ * @param	time_ms		time in ms.
+ *
+ * @returns	uint16_t	number of ticks, limited to 0xFFFF.
+ **************************************************************************************************/
+
+static uint16_t __task_ticks_from_now(uint16_t time_ms)
+{
+	uint8_t irq_flag = rtos_cli();
+	uint16_t current_time = __timer_get_time_ms();
+	rtos_sei(irq_flag);
+	uint32_t ticks = (uint32_t)__timer_ms_to_ticks_16bits(time_ms) + (uint32_t)current_time;
+	
+	return (ticks > 0xFFFF) ? 0xFFFF : (uint16_t)ticks;
 }
 
 
@@ -624,14 +1109,10 @@ __attribute__ ((noinline)) void __task_delay(uint16_t time_ms)
 	
 	if(task != NULL){
 		if(time_ms){
-			uint8_t irq_flag = rtos_cli();
-			uint16_t current_time = __timer_get_time_ms();
-			rtos_sei(irq_flag);
-			uint32_t sleep = (uint32_t)__timer_ms_to_ticks_16bits(time_ms) + (uint32_t)current_time;
+			uint16_t sleep = __task_ticks_from_now(time_ms);
 			
-			task->sleep_time = (sleep > 0xFFFF) ? 0xFFFF : (uint16_t)sleep;
 			task_freeze(SLEEP_TIMED, task);
-			task_list_push_front((task_handle_t **)&__task_sleeping_g, task);
+			__task_sleeping_insert(task, sleep);
 			
 		}else{
 			task_freeze(SLEEP_INFINITE, task);
@@ -641,33 +1122,172 @@ __attribute__ ((noinline)) void __task_delay(uint16_t time_ms)
 }
 
 
+/**********************************************************************************************//**
+ * @fn	void __task_delay_until(uint32_t *last_wake, uint16_t period_ms)
+ *
+ * @brief	The function puts the currently working task to sleep until the absolute time *last_wake + period_ms,
+ *			*last_wake is moved to the new wake up time, so the period does not drift.
+ *
+ * @param	last_wake	pointer to the last wake up time in system ms.
+ * @param	period_ms	period in ms.
+ **************************************************************************************************/
+
+__attribute__ ((noinline)) void __task_delay_until(uint32_t *last_wake, uint16_t period_ms)
+{
+	task_handle_t *task = (task_handle_t *)__task_ready_g;
+	
+	if( (task != NULL) && (last_wake != NULL) ){
+		uint8_t irq_flag = rtos_cli();
+		uint16_t current_time = __timer_get_time_ms();
+		uint32_t now = rtos_get_system_time_ms();
+		rtos_sei(irq_flag);
+		
+		*last_wake += __timer_ms_to_ticks_16bits(period_ms);
+		int32_t sleep = (int32_t)(*last_wake - now);
+		
+		if(sleep > 0){		//if the wake up time has already passed, the task only gives up the CPU
+			sleep += current_time;
+			
+			task_freeze(SLEEP_TIMED, task);
+			__task_sleeping_insert(task, (sleep > 0xFFFF) ? 0xFFFF : (uint16_t)sleep);
+		}
+	}
+	rtos_back_jump();
+}
+
+
+#if BOARD_task_timeouts == TRUE
+
+/**********************************************************************************************//**
+ * @fn	void __task_timeout_start(task_handle_t *task, uint16_t time_ms)
+ *
+ * @brief	Used by the system to limit the time a frozen task waits for a semaphore, mutex, interrupt or memory.
+ *			The task is added to the list of timeouts and stays in the list of the object it is waiting for,
+ *			whichever comes first removes the task from the other list.
+ *			If the time is equal to 0, the task waits without a timeout.
+ *
+ * @param	task		waiting task.
+ *			time_ms		timeout in ms.
+ **************************************************************************************************/
+
+void __task_timeout_start(task_handle_t *task, uint16_t time_ms)
+{
+	if(task == NULL)return;
+	
+	if(time_ms){
+		__task_timeout_insert(task, __task_ticks_from_now(time_ms));
+	}else{
+		task->timeout.time = 0;
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t __task_timeout_expired(void)
+ *
+ * @brief	Used by the wait macros with a timeout to check why the last wait of the currently running task ended,
+ *			the information is cleared after reading.
+ *
+ * @returns	uint8_t		TRUE - the time ran out, FALSE - the task got what it was waiting for.
+ **************************************************************************************************/
+
+uint8_t __task_timeout_expired(void)
+{
+	task_handle_t *task = (task_handle_t *)__task_ready_g;
+	uint8_t expired = FALSE;
+	
+	if( (task != NULL) && (task->timeout.time == TASK_timeout_expired) ){
+		task->timeout.time	= 0;
+		expired				= TRUE;
+	}
+	return expired;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __task_refresh_timeouts(uint16_t time_ms)
+ *
+ * @brief	the function refreshes the time in the list of timeouts, the tasks whose time ran out
+ *			are removed from the list of the object they are waiting for and woken up.
+ *
+ * @param	time	value to subtract from the timeouts.
+ **************************************************************************************************/
+
+static void __task_refresh_timeouts(uint16_t time_ms)
+{
+	task_handle_t *waiting_task;
+	
+	while( (waiting_task = (task_handle_t *)__task_timeout_g) != NULL )
+	{
+		if(waiting_task->timeout.time > time_ms){
+			waiting_task->timeout.time -= time_ms;
+			break;
+		}
+		time_ms -= waiting_task->timeout.time;
+		waiting_task->timeout.time = 0;		//the time is used up, nothing is passed to the next task
+		__task_timeout_remove(waiting_task);
+		waiting_task->timeout.time = TASK_timeout_expired;
+		
+		if(waiting_task->state == WAIT_SEMA){
+			semaphore_remove_from_pending_list(waiting_task, waiting_task->sleep_sema);
+		}
+		task_unfreeze(waiting_task);
+	}
+}
+
+#endif
+
+
 /**********************************************************************************************//**
  * @fn	void __task_refresh_delayed(uint16_t time_ms)
  *
- * @brief	Used by the system to refresh the time in all tasks
+ * @brief	Used by the system to refresh the time in all tasks,
+ *			only the expired tasks and the first still sleeping task are visited.
  *
  * @param	time	value to subtract from all tasks counters.
  **************************************************************************************************/
 
 __attribute__((noinline))void __task_refresh_delayed(uint16_t time_ms)
 {
-	task_handle_t *asleep_task = (task_handle_t *)__task_sleeping_g;
+	task_handle_t *asleep_task;
+	
+#if BOARD_task_timeouts == TRUE
+	__task_refresh_timeouts(time_ms);
+#endif
 	
-	while(asleep_task != NULL)
+	while( (asleep_task = (task_handle_t *)__task_sleeping_g) != NULL )
 	{
-		task_handle_t *next_asleep_task = asleep_task->next_task;
-
-		if(asleep_task->sleep_time <= time_ms){
-			task_unfreeze(asleep_task);
-			
-		}else{
+		if(asleep_task->sleep_time > time_ms){
 			asleep_task->sleep_time -= time_ms;
+			break;
 		}
-		asleep_task = next_asleep_task;
+		time_ms -= asleep_task->sleep_time;
+		asleep_task->sleep_time = 0;		//the time is used up, nothing is passed to the next task
+		task_unfreeze(asleep_task);
 	}
 }
 
 
+/**********************************************************************************************//**
+ * @fn	uint16_t __task_get_nearest_wakeup(void)
+ *
+ * @brief	Used by the system to find the time to the nearest wake up of a sleeping task or the nearest timeout of a waiting task
+ *
+ * @returns	uint16_t	the lowest sleep time or 0xFFFF if no task is sleeping or waiting with a timeout.
+ **************************************************************************************************/
+
+uint16_t __task_get_nearest_wakeup(void)
+{
+	uint16_t wakeup = (__task_sleeping_g != NULL) ? __task_sleeping_g->sleep_time : 0xFFFF;
+#if BOARD_task_timeouts == TRUE
+	if( (__task_timeout_g != NULL) && (__task_timeout_g->timeout.time < wakeup) ){
+		wakeup = __task_timeout_g->timeout.time;
+	}
+#endif
+	return wakeup;
+}
+
+
 /**********************************************************************************************//**
  * @fn	void __task_join(task_handle_t *child_task, uint8_t wait_2_join, uint16_t parent_pc)
  *
@@ -774,9 +1394,11 @@ __attribute__ ((noinline)) void __task_infinite_sleep(uint8_t wake_up)
  *			The task parent will be woken up, the task children will be deleted,
  *			all mutexes will be unlocked, all counters will be stopped, the task destructor will be called.
  *			If if_permanent is TRUE, the dynamic memory occupied by the task will be freed.
+ *			If TASK_erase_free_memory is added, all the heap memory allocated by the task will be freed as well.
  *
  * @param	if_permanent	TRUE - the dynamic memory occupied by the task will be freed
  *							FALSE - the dynamic memory occupied by the task will not be freed
+ *							TASK_erase_free_memory can be added to both values with |
  *			task			task to erase, by default this function argument is null
  *							it means call this function for currently running task
  *
@@ -814,34 +1436,36 @@ __attribute__ ((noinline)) void _task_erase(uint8_t if_permanent, task_handle_t
 	}
 
 	while(task->family.child_task != NULL){
-		task_erase(TRUE, task->family.child_task);
+		task_erase(TRUE | (if_permanent & TASK_erase_free_memory), task->family.child_task);
 	}
 		
 	task->PC = task->code_addr;
+	__task_timeout_remove(task);
 		
 	if(task == __task_ready_g){
 		this_is_currently_running = TRUE;
 		task_freeze(STOPPED, task);
 		
 	}else if(task->state == SLEEP_TIMED){
-		task->sleep_time = 0;
-		task_list_remove_by_item((task_handle_t **)&__task_sleeping_g, task);
+		__task_sleeping_remove(task);
 		
 	}else if(task->state == INTERRUPT){
-		task->sleep_irq_num = 0;
-		task_list_remove_by_item((task_handle_t **)&__task_interrupted_g, task);
+		__task_irq_waiter_remove(task);
 	
 	}else if(task->state == WAIT_SEMA){
 		semaphore_remove_from_pending_list(task, task->sleep_sema);
 		
-	}else if(task->state == READY){
-		if(task->prev_task){
-			(task->prev_task)->next_task = task->next_task;
-		}
-		if(task->next_task){
-			(task->next_task)->prev_task = task->prev_task;
-		}
+	}else if(__task_is_ready(task)){
+		__task_ready_remove(task);
+	}
+	
+	if(task->heap_request == TASK_heap_request_granted){		//the memory handed over by the heap has not been picked up
+		heap_free(__heap_get_block_address(task->heap_block));
 	}
+	task->heap_request = TASK_heap_request_none;
+#if BOARD_task_timeouts == TRUE
+	task->timeout.time = 0;
+#endif
 	task->state      = STOPPED;
 	task->next_task  = NULL;
 	task->prev_task  = NULL;
@@ -854,7 +1478,15 @@ __attribute__ ((noinline)) void _task_erase(uint8_t if_permanent, task_handle_t
 	if(task->destructor_f != NULL){
 		task->destructor_f(task);
 	}
-	if(if_permanent){
+#if BOARD_heap_owner_tracking == TRUE
+	if(if_permanent & TASK_erase_free_memory){
+		heap_free_task_memory(task);
+	}
+	if(if_permanent & TRUE){
+		__heap_clear_owner(task);		//the memory left by the task is not taken over by a new task created at the same address
+	}
+#endif
+	if(if_permanent & TRUE){
 		heap_free(task);
 	}
 	if(this_is_currently_running){
@@ -16,6 +16,15 @@
 	#error "BOARD_heap_single_block_size must be at least equal to 32"
 #endif
 
+#if (BOARD_task_number_of_priorities < 1) || (BOARD_task_number_of_priorities > 8)
+	#error "BOARD_task_number_of_priorities must be between 1 and 8"
+#endif
+
+
+#define TASK_priority_idle		0													//reserved for the idle task
+#define TASK_priority_default	((BOARD_task_number_of_priorities > 1) ? 1 : 0)		//priority set by task_setup
+#define TASK_priority_highest	(BOARD_task_number_of_priorities - 1)
+
 
 /**********************************************************************************************//**
  * @enum	task_state_t
@@ -53,9 +62,13 @@ typedef struct task_handle{
 		volatile uint16_t		sleep_time;
 		struct semaphore		*sleep_sema;
 		uint8_t					sleep_irq_num;
+		uint8_t					heap_block;		//the first block handed over by the heap, valid if heap_request is TASK_heap_request_granted
 	};
 	   		
 	task_state_t	state;
+	uint8_t			priority;					//the priority the task is run with, raised while a task with a higher priority waits for its mutex
+	uint8_t			base_priority;				//the priority set by task_set_priority()
+	uint8_t			heap_request;				//number of heap blocks the task is waiting for
 
 	struct{
 		struct task_handle 	*parent_task;
@@ -66,6 +79,15 @@ typedef struct task_handle{
 	struct task_handle 		*next_task;
 	struct task_handle 		*prev_task;
 
+#if BOARD_task_timeouts == TRUE
+	struct{
+		struct task_handle 	*next_task;
+		struct task_handle 	*prev_task;
+		uint16_t			time;			//time relative to the previous task in the list of timeouts, TASK_timeout_expired if the time ran out
+				
+	}timeout;
+#endif
+
 	struct semaphore 		*head_mutexes_list;
 
 	void (*destructor_f)(struct task_handle *task);
@@ -75,6 +97,10 @@ typedef struct task_handle{
 
 #define TASK_number_of_dynamic_variables	(BOARD_heap_single_block_size - sizeof(task_handle_t))
 #define TASK_del_all_tasks					NULL
+#define TASK_heap_request_none				0x00
+#define TASK_heap_request_granted			0xFF
+#define TASK_timeout_expired				0xFFFF			//set in the timeout time of a task which is no longer in the list of timeouts
+#define TASK_erase_free_memory				0x02			//task_erase option, all the heap memory allocated by the task is freed
 
 #ifndef RUN_TESTS
 	#define TASK_my_task_t					__attribute__((OS_task, noinline)) void
@@ -130,14 +156,27 @@ typedef struct{
 
 
 void __task_delay(uint16_t time_ms);
+void __task_delay_until(uint32_t *last_wake, uint16_t period_ms);
 void __task_join(task_handle_t *child_task, uint8_t wait_2_join, uint16_t parent_pc);
 void __task_infinite_sleep(uint8_t wake_up);
 void * __task_new(void (*task_code_addr)(void), void (*destructor_call_addr)(task_handle_t *));
 void __task_refresh_delayed(uint16_t time_ms);
+uint16_t __task_get_nearest_wakeup(void);
 void __task_refresh_interrupted(void);
 void __task_wait_for_irq(uint8_t irq_nr);
+void __task_wait_for_irq_timeout(uint8_t irq_nr, uint16_t time_ms);
+#if BOARD_task_timeouts == TRUE
+void __task_timeout_start(task_handle_t *task, uint16_t time_ms);
+void __task_timeout_remove(task_handle_t *task);
+uint8_t __task_timeout_expired(void);
+#else
+#define __task_timeout_start(task, time_ms)
+#define __task_timeout_remove(task)
+#define __task_timeout_expired()				FALSE
+#endif
 void __task_set_program_counter(uint16_t pc);
 void __task_switch(void);
+void __task_change_priority(task_handle_t *task, uint8_t priority);
 void * _task_new(void *(*heap_malloc_f)(uint16_t), void (*task_code_addr)(void), void (*destructor_call_addr)(task_handle_t *));
 
 
@@ -206,7 +245,8 @@ void __task_get_dynamic_variables_handle(void);
 /**********************************************************************************************//**
  * @fn	void task_list_remove_by_item(task_handle_t **head, task_handle_t *item)
  *
- * @brief	function removes a specific item from a doubly linked list.
+ * @brief	function removes a specific item from a doubly linked list in constant time,
+ *			the item has to be in the given list or in no list.
  *
  * @param		head   	pointer to pointer to the top of the lists.
  *				item	item to remove
@@ -261,6 +301,43 @@ void task_list_push_front(task_handle_t **head, task_handle_t *new_task);
 void task_list_push_back(task_handle_t **head, task_handle_t *new);
 
 
+/**********************************************************************************************//**
+ * @fn	void task_queue_push_back(task_handle_t **head, task_handle_t *new_task)
+ *
+ * @brief	the function adds a new item to the end of the queue in constant time.
+ *			The queue is a doubly linked list whose first item points to the last one as its prev_task,
+ *			the next_task of the last item is NULL. The queue must be changed only by the task_queue functions.
+ *
+ * @param		head   		pointer to pointer to the top of the queue.
+ * @param		new_task   	new item to add to the queue.
+ **************************************************************************************************/
+void task_queue_push_back(task_handle_t **head, task_handle_t *new_task);
+
+
+/**********************************************************************************************//**
+ * @fn	task_handle_t *task_queue_pop_front(task_handle_t **head)
+ *
+ * @brief	the function removes an item from the beginning of the queue in constant time.
+ *
+ * @param		head   	pointer to pointer to the top of the queue.
+ *
+ * @returns	task_handle_t *  address of the deleted item or NULL.
+ **************************************************************************************************/
+task_handle_t *task_queue_pop_front(task_handle_t **head);
+
+
+/**********************************************************************************************//**
+ * @fn	void task_queue_remove_by_item(task_handle_t **head, task_handle_t *item)
+ *
+ * @brief	the function removes a specific item from the queue in constant time, the item has to be in the queue.
+ *
+ * @param		head   	pointer to pointer to the top of the queue.
+ *				item	item to remove
+ *
+ **************************************************************************************************/
+void task_queue_remove_by_item(task_handle_t **head, task_handle_t *item);
+
+
 /**********************************************************************************************//**
  * @fn	void task_init(void)
  *
@@ -338,16 +415,60 @@ struct semaphore *_task_get_first_mutex_from_list(task_handle_t *task);
 #define _task_get_first_mutex_from_list1(task)		_task_get_first_mutex_from_list(task)
 
 
+/**********************************************************************************************//**
+ * @fn	uint8_t task_ready_count(void)
+ *
+ * @brief	the function returns the number of currently running tasks in constant time. 
+ *
+ * @returns	uint8_t  number of tasks.
+ **************************************************************************************************/
+uint8_t task_ready_count(void);
+
+
 /**********************************************************************************************//**
  * @fn	uint8_t task_get_number_of_running_tasks(void)
  *
- * @brief	the function returns the number of currently running tasks. 
+ * @brief	the function returns the number of currently running tasks, the same as task_ready_count(). 
  *
  * @returns	uint8_t  number of tasks .
  **************************************************************************************************/
 uint8_t task_get_number_of_running_tasks(void);
 
 
+/**********************************************************************************************//**
+ * @fn	void task_set_priority(uint8_t priority, task_handle_t *task=task_this())
+ *
+ * @brief	the function sets the priority of a given task. The scheduler always runs
+ *			the tasks with the highest priority first, tasks with the same priority are run in turn.
+ *			Values above TASK_priority_highest are limited to TASK_priority_highest.
+ *			While the task owns a mutex a task with a higher priority waits for, it runs with the priority of the waiting task.
+ *
+ * @param	priority	new priority, from TASK_priority_idle to TASK_priority_highest
+ *			task   		pointer to the task, by default this function argument is null
+ *						it means call this function for currently running task
+ **************************************************************************************************/
+void _task_set_priority(uint8_t priority, task_handle_t *task);
+#define task_set_priority(...)					VRG(_task_set_priority, __VA_ARGS__)
+#define _task_set_priority1(priority)			_task_set_priority(priority, NULL)
+#define _task_set_priority2(priority, task)		_task_set_priority(priority, task)
+
+
+/**********************************************************************************************//**
+ * @fn	uint8_t task_get_priority(task_handle_t *task=task_this())
+ *
+ * @brief	the function returns the priority the given task is run with, it includes the priority inherited through the mutexes. 
+ *
+ * @param	task   	pointer to the task, by default this function argument is null
+ *					it means call this function for currently running task
+ *
+ * @returns	uint8_t  task priority.
+ **************************************************************************************************/
+uint8_t _task_get_priority(task_handle_t *task);
+#define task_get_priority(...)			VRG(_task_get_priority, __VA_ARGS__)
+#define _task_get_priority0()			_task_get_priority(NULL)
+#define _task_get_priority1(task)		_task_get_priority(task)
+
+
 /**********************************************************************************************//**
  * @fn	uint16_t task_get_function_address(task_handle_t *task=task_this())
  *
@@ -395,7 +516,8 @@ task_state_t task_get_state(task_handle_t *task);
 /**********************************************************************************************//**
  * @fn	void task_setup(task_rtos_handle_t *task, void (*task_code_addr)(void), void (*destructor_call_addr)(task_rtos_handle_t *)=NULL)
  *
- * @brief	the function will initialize a new task
+ * @brief	the function will initialize a new task, the task priority is set to TASK_priority_default
+ *			and the task owns no mutex. Set another priority with task_set_priority() after the setup.
  *
  * @param	task					task address
  *			task_code_addr			task program address.
@@ -420,8 +542,8 @@ void _task_setup(task_handle_t *task, void (*task_code_addr)(void), void (*destr
  * @returns	void *		task address or NULL if there is no free dynamic memory.
  **************************************************************************************************/
 #define task_new(...)												VRG(_task_new, __VA_ARGS__)
-#define _task_new1(task_code_addr)							_task_new(heap_malloc, task_code_addr, NULL)
-#define _task_new2(task_code_addr, destructor_call_addr)	_task_new(heap_malloc, task_code_addr, destructor_call_addr)
+#define _task_new1(task_code_addr)							_task_new(heap_calloc, task_code_addr, NULL)
+#define _task_new2(task_code_addr, destructor_call_addr)	_task_new(heap_calloc, task_code_addr, destructor_call_addr)
 
 
 /**********************************************************************************************//**
@@ -436,8 +558,8 @@ void _task_setup(task_handle_t *task, void (*task_code_addr)(void), void (*destr
  * @returns	void *		task address.
  **************************************************************************************************/
 #define condWait_task_new(...)								task_update_pc_addr_before_call(VRG(__task_new, __VA_ARGS__))
-#define __task_new1(task_code_addr)							_task_new(__heap_malloc, task_code_addr, NULL)
-#define __task_new2(task_code_addr, destructor_call_addr)	_task_new(__heap_malloc, task_code_addr, destructor_call_addr)
+#define __task_new1(task_code_addr)							_task_new(__heap_calloc, task_code_addr, NULL)
+#define __task_new2(task_code_addr, destructor_call_addr)	_task_new(__heap_calloc, task_code_addr, destructor_call_addr)
 		
 
 /**********************************************************************************************//**
@@ -463,7 +585,7 @@ task_handle_t * _task_freeze(task_state_t new_task_state, task_handle_t *task);
  *
  * @brief	This function adds a task to the list of currently working tasks and sets a state to READY.
  *			If a task wakes up after temporarily sleeping or waiting for an interrupt, 
- *			it will be placed at the top of the task queue.
+ *			it will be placed at the top of the queue of its priority level.
  *			otherwise it will be placed at the end of the queue.
  *
  * @param	wakeup_task		task to wakeup.
@@ -475,12 +597,35 @@ void task_unfreeze(task_handle_t *wakeup_task);
  * @fn	void condWait_task_wait_irq(rtos_irq_t irq_nr)
  *
  * @brief	This function will suspend the currently running task until the given irq_nr is reported.
+ *			One report wakes up all tasks waiting for the irq_nr at that time and is consumed,
+ *			a task starting to wait later needs a new report.
  *
  * @param	irq_nr		irq number to check.
  *
  **************************************************************************************************/
 #define condWait_task_wait_irq(irq_nr)\
 			task_update_pc_addr_after_call(__task_wait_for_irq(irq_nr))
+
+
+#if BOARD_task_timeouts == TRUE
+
+/**********************************************************************************************//**
+ * @fn	uint8_t condWait_task_wait_irq_timeout(rtos_irq_t irq_nr, uint16_t time_ms)
+ *
+ * @brief	This function will suspend the currently running task until the given irq_nr is reported
+ *			or the time runs out. If the time is equal to 0, the task waits without a timeout.
+ *			One report wakes up all tasks waiting for the irq_nr, as condWait_task_wait_irq() does.
+ *
+ * @param	irq_nr		irq number to check.
+ *			time_ms		timeout in ms.
+ *
+ * @returns	uint8_t		TRUE - the irq has been reported, FALSE - the time ran out.
+ **************************************************************************************************/
+#define condWait_task_wait_irq_timeout(irq_nr, time_ms)({\
+			task_update_pc_addr_after_call(__task_wait_for_irq_timeout(irq_nr, time_ms));\
+			(__task_timeout_expired() == FALSE);\
+		})
+#endif
 			
 
 /**********************************************************************************************//**
@@ -506,6 +651,21 @@ uint8_t task_check_if_any_is_waiting_for_irq(void);
 			task_update_pc_addr_after_call(__task_delay(time_ms))
 
 
+/**********************************************************************************************//**
+ * @fn	void condWait_task_delay_until(uint32_t *last_wake, uint16_t period_ms)
+ *
+ * @brief	The function puts the currently working task to sleep until the absolute time *last_wake + period_ms.
+ *			The wake up time is counted from the previous one and not from now, so the execution time of the task
+ *			does not add drift. Initialize last_wake with rtos_get_system_time_ms() before the first call,
+ *			if the wake up time has already passed the task only gives up the CPU.
+ *
+ * @param	last_wake	pointer to the last wake up time, updated to the next wake up time.
+ * @param	period_ms	period in ms.
+ **************************************************************************************************/
+#define condWait_task_delay_until(last_wake, period_ms)\
+			task_update_pc_addr_after_call(__task_delay_until(last_wake, period_ms))
+
+
 /**********************************************************************************************//**
  * @fn	void condWait_task_join(task_handle_t *child_task)
  *
@@ -588,9 +748,11 @@ void  task_start(task_handle_t *task);
  *			The task parent will be woken up, the task children will be deleted,
  *			all mutexes will be unlocked, all counters will be stopped, the task destructor will be called.
  *			If if_permanent is TRUE, the dynamic memory occupied by the task will be freed.
+ *			If TASK_erase_free_memory is added, all the heap memory allocated by the task will be freed as well.
  *
  * @param	if_permanent	TRUE - the dynamic memory occupied by the task will be freed
  *							FALSE - the dynamic memory occupied by the task will not be freed
+ *							TASK_erase_free_memory can be added to both values with |
  *			task			task to erase, by default this function argument is null
  *							it means call this function for currently running task
  *
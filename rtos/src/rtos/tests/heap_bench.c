@@ -0,0 +1,145 @@
+/*
+ * heap_bench.c
+ */
+#if defined(RUN_TESTS) && defined(RUN_HEAP_BENCH)
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <string.h>
+#include "test.h"
+#include "rtos.h"
+
+
+#define HEAP_BENCH_number_of_slots		16
+#define HEAP_BENCH_number_of_traces		3
+#define HEAP_BENCH_churn_operations		200
+#define HEAP_BENCH_free					0			//the operation frees the slot
+
+
+typedef struct{
+	uint16_t	operations;
+	uint16_t	failed_allocations;
+	uint8_t		max_fragmentation;
+	uint8_t		avg_fragmentation;
+	uint16_t	min_largest_free_bytes;
+	uint32_t	cycles;					//CPU cycles spent in the allocations and releases
+}heap_bench_result_t;
+
+
+//the traces are synthetic, written by hand after the typical use cases, not recorded on a device.
+//They are pairs {slot, number of blocks}, 0 blocks frees the slot
+static const uint8_t heap_bench_protocol_trace[] PROGMEM = {		//long lived handles between the frame buffers
+	0, 1,	1, 4,	2, 1,	3, 4,	1, 0,	4, 2,	5, 1,	3, 0,	6, 4,	7, 1,
+	4, 0,	8, 3,	6, 0,	9, 1,	10, 4,	8, 0,	11, 2,	2, 0,	12, 4,	10, 0,
+	13, 1,	11, 0,	14, 3,	12, 0,	15, 4,	14, 0,	1, 2,	15, 0,	3, 4,	1, 0,
+	3, 0,	0, 0,	5, 0,	7, 0,	9, 0,	13, 0
+};
+
+static const uint8_t heap_bench_logger_trace[] PROGMEM = {		//the sample buffers grow while the old ones are stored
+	0, 1,	1, 1,	2, 2,	0, 0,	3, 3,	1, 0,	4, 4,	2, 0,	5, 5,	3, 0,
+	6, 1,	4, 0,	7, 6,	5, 0,	8, 2,	9, 1,	6, 0,	10, 3,	8, 0,	11, 2,
+	7, 0,	12, 1,	9, 0,	13, 5,	10, 0,	11, 0,	14, 4,	12, 0,	13, 0,	14, 0
+};
+
+static const uint8_t * const heap_bench_traces[] = {heap_bench_protocol_trace, heap_bench_logger_trace};
+static const uint8_t heap_bench_trace_sizes[] = {sizeof(heap_bench_protocol_trace), sizeof(heap_bench_logger_trace)};
+
+heap_bench_result_t	heap_bench_results[HEAP_BENCH_number_of_traces];		//read them in the debugger, one build per placement
+uint8_t				heap_bench_placement = BOARD_heap_placement;
+static void			*heap_bench_slots[HEAP_BENCH_number_of_slots];
+
+
+/**********************************************************************************************//**
+ * @fn	static void heap_bench_operation(heap_bench_result_t *result, uint8_t slot, uint8_t blocks_num, uint16_t *fragmentation_sum)
+ *
+ * @brief	the function replays one operation of the trace and measures it with the timer 1 counting the CPU cycles
+ *
+ * @param		result				the results of the trace.
+ * @param		slot				slot of the memory.
+ * @param		blocks_num			number of blocks to allocate, HEAP_BENCH_free - the slot is freed.
+ * @param		fragmentation_sum	sum of the fragmentation after each operation.
+ **************************************************************************************************/
+
+static void heap_bench_operation(heap_bench_result_t *result, uint8_t slot, uint8_t blocks_num, uint16_t *fragmentation_sum)
+{
+	heap_stats_t stats;
+
+	slot %= HEAP_BENCH_number_of_slots;
+
+	if( (blocks_num == HEAP_BENCH_free) && (heap_bench_slots[slot] == NULL) )return;
+
+	TCNT1 = 0;
+
+	if(blocks_num == HEAP_BENCH_free){
+		heap_free(heap_bench_slots[slot]);
+		heap_bench_slots[slot] = NULL;
+
+	}else{
+		if(heap_bench_slots[slot] != NULL){
+			heap_free(heap_bench_slots[slot]);
+		}
+		heap_bench_slots[slot] = heap_malloc_raw((uint16_t)blocks_num * BOARD_heap_single_block_size);
+	}
+	result->cycles += TCNT1;
+
+	if( (blocks_num != HEAP_BENCH_free) && (heap_bench_slots[slot] == NULL) ){
+		result->failed_allocations++;
+	}
+	heap_get_stats(&stats);
+	result->operations++;
+	*fragmentation_sum += stats.fragmentation;
+
+	if(stats.fragmentation > result->max_fragmentation){
+		result->max_fragmentation = stats.fragmentation;
+	}
+	if(stats.largest_free_bytes < result->min_largest_free_bytes){
+		result->min_largest_free_bytes = stats.largest_free_bytes;
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void heap_bench(void)
+ *
+ * @brief	the function replays the synthetic allocation traces and a pseudo random churn on the empty heap
+ *			and fills heap_bench_results for the placement set in BOARD_heap_placement
+ *
+ **************************************************************************************************/
+
+void heap_bench(void)
+{
+	uint8_t timer_control = TCCR1B;
+
+	TCCR1A = 0x00;
+	TCCR1B = _BV(CS10);					//the timer counts the CPU cycles
+
+	for(uint8_t trace = 0; trace < HEAP_BENCH_number_of_traces; trace++){
+		heap_bench_result_t *result	= &heap_bench_results[trace];
+		uint16_t fragmentation_sum	= 0;
+		uint16_t random				= 0xACE1;
+
+		memset(result, 0x00, sizeof(heap_bench_result_t));
+		result->min_largest_free_bytes = heap_get_size_of_free_memory();
+
+		if(trace < sizeof(heap_bench_trace_sizes)){
+			for(uint8_t i = 0; i < heap_bench_trace_sizes[trace]; i += 2){
+				heap_bench_operation(result, pgm_read_byte(&heap_bench_traces[trace][i]),
+										pgm_read_byte(&heap_bench_traces[trace][i + 1]), &fragmentation_sum);
+			}
+		}else{
+			for(uint8_t i = 0; i < HEAP_BENCH_churn_operations; i++){
+				random = (random >> 1) ^ ((random & 0x01) ? 0xB400 : 0x0000);		//LFSR, the churn is the same for every placement
+				heap_bench_operation(result, (uint8_t)random & 0x07, (random & 0x0300) ? ((random >> 4) % 3) + 1 : HEAP_BENCH_free, &fragmentation_sum);
+			}
+		}
+		for(uint8_t slot = 0; slot < HEAP_BENCH_number_of_slots; slot++){
+			heap_free(heap_bench_slots[slot]);
+			heap_bench_slots[slot] = NULL;
+		}
+		if(result->operations != 0){
+			result->avg_fragmentation = (uint8_t)(fragmentation_sum / result->operations);
+		}
+	}
+	TCCR1B = timer_control;
+}
+
+#endif
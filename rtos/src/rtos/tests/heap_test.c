@@ -14,10 +14,43 @@
 
 
 uint8_t * volatile task_mem;
+uint8_t * volatile task_single_block_mem;
+static heap_region_t test_region;
+static uint8_t test_region_memory[64];
+static heap_pool_t test_pool;
+static uint8_t test_pool_memory[16 * 2];
+
+#define TEST_heap_bytes(blocks_num)		((blocks_num) * BOARD_heap_single_block_size - HEAP_debug_canary_size)		//the request filling the blocks together with the canary
 
 static void test_task(void)
 {
-	task_mem = condWait_heap_malloc(BOARD_heap_single_block_size*2);
+	task_mem = condWait_heap_malloc(TEST_heap_bytes(2));
+}
+
+static void test_task_single_block(void)
+{
+	task_single_block_mem = condWait_heap_malloc(TEST_heap_bytes(1));
+}
+
+#if BOARD_heap_owner_tracking == TRUE
+static void test_task_owner(void)
+{
+	task_mem				= heap_malloc(TEST_heap_bytes(1));
+	task_single_block_mem	= heap_malloc(TEST_heap_bytes(2));
+	TEST(heap_get_usage() == BOARD_heap_single_block_size*3);
+	heap_free(task_mem);
+	TEST(heap_get_usage() == BOARD_heap_single_block_size*2);
+	task_mem				= heap_malloc(1);
+	task_erase(FALSE | TASK_erase_free_memory);			//the task does not free its memory, task_erase does it
+}
+#endif
+
+extern void (*rtos_response_on_error)(int8_t sign, uint32_t err_code);
+static uint32_t test_err_code;
+
+static void test_on_error(int8_t sign, uint32_t err_code)
+{
+	test_err_code = err_code;
 }
 
 
@@ -37,18 +70,24 @@ void heap_test(void)
 	uint8_t *volatile mem_ptr[MEM_PTR_SIZE];
 	uint16_t free_mem_size = BOARD_heap_number_of_blocks * BOARD_heap_single_block_size;
 	uint8_t *volatile ptr;
+	heap_stats_t stats;
+	uint16_t stats_counter;
+	void (*response_on_error)(int8_t, uint32_t);
+#if BOARD_heap_number_of_handles > 0
+	heap_handle_t handle;
+#endif
 
 	void malloc_all_memory(void)
 	{
 		//allocate the entire memory according to the following method: MEM_PTR_SIZE - 1 allocations of one block size and one allocation occupying the rest of the free memory
 		for(uint8_t i=0; i<MEM_PTR_SIZE - 1; i++){
 			if(mem_ptr[i] == NULL){
-				mem_ptr[i] = heap_malloc(BOARD_heap_single_block_size);
+				mem_ptr[i] = heap_malloc(TEST_heap_bytes(1));
 				free_mem_size -= BOARD_heap_single_block_size;
 			}
 		}
 		if(mem_ptr[MEM_PTR_SIZE - 1] == NULL){
-			mem_ptr[MEM_PTR_SIZE-1] = heap_malloc(BOARD_heap_single_block_size * (BOARD_heap_number_of_blocks - MEM_PTR_SIZE + 1));
+			mem_ptr[MEM_PTR_SIZE-1] = heap_malloc(TEST_heap_bytes(BOARD_heap_number_of_blocks - MEM_PTR_SIZE + 1));
 			free_mem_size -= BOARD_heap_single_block_size * (BOARD_heap_number_of_blocks - MEM_PTR_SIZE + 1);
 		}
 	}
@@ -71,24 +110,12 @@ void heap_test(void)
 		test_rtos_task_call(0, FALSE);
 		TEST(test_rtos_task_handle(0)->state == WAIT_SEMA);
 		
-		//free one block
+		//free one block, the task needs two blocks next to each other so it should keep waiting
 		free_memory(0);
-		
-		//the task should run once memory is freed
-		TEST(test_rtos_task_handle(0)->state == READY);
-
-		//there is not enough free memory so the task should be added to waiting tasks queue
-		test_rtos_task_call(0, FALSE);
 		TEST(test_rtos_task_handle(0)->state == WAIT_SEMA);
 		
-		//free one block
+		//free one block, there are still no two free blocks next to each other
 		free_memory(4);
-		
-		//the task should run once memory is freed
-		TEST(test_rtos_task_handle(0)->state == READY);
-
-		//there is not enough free memory so the task should be added to waiting tasks queue
-		test_rtos_task_call(0, FALSE);
 		TEST(test_rtos_task_handle(0)->state == WAIT_SEMA);
 		
 		//save the memory address to check if the task receives it after the next steps
@@ -96,10 +123,12 @@ void heap_test(void)
 		//free one block
 		free_memory(3);
 		
-		//the task should run once memory is freed
+		//the blocks 3 and 4 are handed over to the task before it runs
 		TEST(test_rtos_task_handle(0)->state == READY);
+		TEST(heap_get_size_of_free_memory() == free_mem_size - BOARD_heap_single_block_size*2);
+		TEST(heap_malloc(TEST_heap_bytes(2)) == NULL);
 
-		//there is enough free memory so the task should obtain a memory address
+		//the task should obtain the memory address handed over
 		//this address should be equal to ptr
 		test_rtos_task_call(0, FALSE);
 		TEST(task_mem == ptr);
@@ -109,6 +138,40 @@ void heap_test(void)
 		test_rtos_remove_task_from_scheduler(0);
 	}
 	
+	void check_task_malloc_queue(void)
+	{
+		malloc_all_memory();
+		
+		//the first task waits for two blocks, the second one for a single block
+		test_rtos_add_task_to_scheduler(0, test_task);
+		test_rtos_task_call(0, FALSE);
+		test_rtos_add_task_to_scheduler(1, test_task_single_block);
+		test_rtos_task_call(1, FALSE);
+		TEST(test_rtos_task_handle(0)->state == WAIT_SEMA);
+		TEST(test_rtos_task_handle(1)->state == WAIT_SEMA);
+		
+		//a single free block is handed over to the second task, the first one keeps waiting
+		ptr = mem_ptr[5];
+		free_memory(5);
+		TEST(test_rtos_task_handle(0)->state == WAIT_SEMA);
+		TEST(test_rtos_task_handle(1)->state == READY);
+		test_rtos_task_call(1, FALSE);
+		TEST(task_single_block_mem == ptr);
+		
+		heap_free(task_single_block_mem);
+		TEST(test_rtos_task_handle(0)->state == WAIT_SEMA);
+		
+		//two blocks next to each other are free now
+		free_memory(6);
+		TEST(test_rtos_task_handle(0)->state == READY);
+		test_rtos_task_call(0, FALSE);
+		TEST(task_mem == ptr);
+		
+		heap_free(task_mem);
+		test_rtos_remove_task_from_scheduler(0);
+		test_rtos_remove_task_from_scheduler(1);
+	}
+	
 	memset((void *)mem_ptr, 0, (MEM_PTR_SIZE * 2));
 	
 	/****** HEAP INIT ******/
@@ -123,13 +186,264 @@ void heap_test(void)
 
 	
 	//check single block memory allocation
-	check_proper_byte_allocation(BOARD_heap_single_block_size, free_mem_size - BOARD_heap_single_block_size);
+	check_proper_byte_allocation(TEST_heap_bytes(1), free_mem_size - BOARD_heap_single_block_size);
 	
 	//check one block plus one byte memory allocation
-	check_proper_byte_allocation(BOARD_heap_single_block_size + 1, free_mem_size - BOARD_heap_single_block_size * 2);
+	check_proper_byte_allocation(TEST_heap_bytes(1) + 1, free_mem_size - BOARD_heap_single_block_size * 2);
+	
+	//check the allocation of the whole memory and of more than the whole memory
+	check_proper_byte_allocation(TEST_heap_bytes(BOARD_heap_number_of_blocks), 0);
+	TEST(heap_malloc(TEST_heap_bytes(BOARD_heap_number_of_blocks) + 1) == NULL);
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+	
+	//check the memory clearing, the same address is allocated again after the release
+	mem_ptr[0] = heap_malloc_raw(BOARD_heap_single_block_size + 1);
+	memset(mem_ptr[0], 0xAA, BOARD_heap_single_block_size * 2);
+	heap_free(mem_ptr[0]);
+	mem_ptr[0] = heap_malloc_raw(1);
+	TEST(mem_ptr[0][0] == 0xAA);												//the raw memory is not cleared
+	heap_free(mem_ptr[0]);
+	mem_ptr[0] = heap_calloc(1);
+	TEST(mem_ptr[0][0] == 0x00);
+	TEST(mem_ptr[0][BOARD_heap_single_block_size - 1] == 0x00);				//the whole block is cleared
+	TEST(mem_ptr[0][BOARD_heap_single_block_size] == 0xAA);					//the next block is not touched
+	heap_free(mem_ptr[0]);
+	mem_ptr[0] = NULL;
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+	
+	//check the reallocation in place, the memory grows into the free blocks after it and shrinks by releasing the last blocks
+	mem_ptr[0] = heap_malloc_raw(TEST_heap_bytes(1));
+	mem_ptr[0][0] = 0x55;
+	TEST(heap_realloc(mem_ptr[0], TEST_heap_bytes(3)) == mem_ptr[0]);
+	TEST(heap_get_size_of_free_memory() == free_mem_size - BOARD_heap_single_block_size * 3);
+	TEST(heap_realloc(mem_ptr[0], 1) == mem_ptr[0]);
+	TEST(heap_get_size_of_free_memory() == free_mem_size - BOARD_heap_single_block_size);
+	
+	//the memory grows into the free block before it, the content is moved
+	mem_ptr[1] = heap_malloc_raw(TEST_heap_bytes(1));
+	mem_ptr[2] = heap_malloc_raw(TEST_heap_bytes(1));
+	mem_ptr[1][0] = 0x66;
+	heap_free(mem_ptr[0]);
+	ptr = heap_realloc(mem_ptr[1], TEST_heap_bytes(2));
+	TEST(ptr == mem_ptr[0]);
+	TEST(ptr[0] == 0x66);
+	
+	//there are no free blocks around the memory, the content is copied
+	mem_ptr[1] = heap_realloc(ptr, TEST_heap_bytes(3));
+	TEST(mem_ptr[1] == mem_ptr[2] + BOARD_heap_single_block_size);
+	TEST(mem_ptr[1][0] == 0x66);
+	TEST(heap_get_size_of_free_memory() == free_mem_size - BOARD_heap_single_block_size * 4);
+	TEST(heap_realloc(mem_ptr[1], 0) == NULL);
+	heap_free(mem_ptr[2]);
+	memset((void *)mem_ptr, 0, (MEM_PTR_SIZE * 2));
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+	
+	//check the statistics, the largest free run is known without searching the heap
+	mem_ptr[0] = heap_malloc(TEST_heap_bytes(1));
+	mem_ptr[1] = heap_malloc(TEST_heap_bytes(1));
+	heap_free(mem_ptr[0]);
+	heap_get_stats(&stats);
+	TEST(stats.free_bytes == free_mem_size - BOARD_heap_single_block_size);
+	TEST(stats.largest_free_bytes == free_mem_size - BOARD_heap_single_block_size * 2);
+	TEST(stats.min_free_bytes == 0);												//the whole memory has been allocated before
+	TEST(stats.fragmentation == 100 - ((BOARD_heap_number_of_blocks - 2) * 100) / (BOARD_heap_number_of_blocks - 1));
+	stats_counter = stats.failed_allocations;
+	TEST(heap_malloc(TEST_heap_bytes(BOARD_heap_number_of_blocks - 1)) == NULL);
+	heap_get_stats(&stats);
+	TEST(stats.failed_allocations == stats_counter + 1);
+	heap_free(mem_ptr[1]);
+	memset((void *)mem_ptr, 0, (MEM_PTR_SIZE * 2));
+	heap_get_stats(&stats);
+	TEST(stats.largest_free_bytes == free_mem_size);
+	TEST(stats.fragmentation == 0);
+	
+	//the region has its own block size, heap_free() finds the region of the memory
+	TEST(heap_region_init(&test_region, test_region_memory, sizeof(test_region_memory), 8) == 6);
+	ptr = heap_region_malloc(&test_region, 9);
+	TEST(ptr == test_region_memory);
+	TEST(heap_check_if_dynamic_mem(ptr + 15) == TRUE);
+	heap_region_get_stats(&test_region, &stats);
+	TEST(stats.free_bytes == 8 * 4);
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+	heap_free(ptr);
+	heap_region_get_stats(&test_region, &stats);
+	TEST(stats.free_bytes == 8 * 6);
+	
+	//the pool gives the blocks in constant time and counts the empty pool, heap_free() gives the block back to the pool
+	TEST(heap_pool_init(&test_pool, test_pool_memory, sizeof(test_pool_memory), 16) == 2);
+	mem_ptr[0] = heap_pool_get(&test_pool);
+	mem_ptr[1] = heap_pool_get(&test_pool);
+	TEST(mem_ptr[0] == test_pool_memory);
+	TEST(mem_ptr[1] == test_pool_memory + 16);
+	TEST(heap_pool_get(&test_pool) == NULL);
+	TEST(heap_check_if_dynamic_mem(mem_ptr[1]) == TRUE);
+	heap_pool_get_stats(&test_pool, &stats);
+	TEST(stats.failed_allocations == 1);
+	TEST(stats.min_free_bytes == 0);
+	heap_free(mem_ptr[0]);
+	heap_pool_put(&test_pool, mem_ptr[1]);
+	heap_pool_get_stats(&test_pool, &stats);
+	TEST(stats.free_bytes == 16 * 2);
+	
+	//the block given back twice or an address inside the block is refused and reported
+	response_on_error		= rtos_response_on_error;
+	rtos_response_on_error	= test_on_error;
+	test_err_code			= 0;
+	heap_pool_put(&test_pool, mem_ptr[1]);
+	TEST((test_err_code & 0xFFFF0000) == __Err_DeviceSoftware_rtOS_HeapDoubleFree);
+	mem_ptr[1] = heap_pool_get(&test_pool);
+	heap_pool_put(&test_pool, (uint8_t *)mem_ptr[1] + 1);
+	TEST((test_err_code & 0xFFFF0000) == __Err_DeviceSoftware_rtOS_HeapInvalidFree);
+	heap_pool_get_stats(&test_pool, &stats);
+	TEST(stats.free_bytes == 16);
+	test_err_code			= 0;
+	heap_pool_put(&test_pool, mem_ptr[1]);
+	TEST(test_err_code == 0);
+	rtos_response_on_error	= response_on_error;
+	heap_pool_get_stats(&test_pool, &stats);
+	TEST(stats.free_bytes == 16 * 2);
+	memset((void *)mem_ptr, 0, (MEM_PTR_SIZE * 2));
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+	
+#if BOARD_heap_persistent_size > 0
+	//the persistent memory is found by its name, heap_free() releases the name
+	ptr = heap_persistent_malloc("test", 1);
+	TEST(ptr != NULL);
+	TEST(heap_check_if_dynamic_mem(ptr) == TRUE);
+	TEST(heap_persistent_malloc("test", 1) == ptr);
+	TEST(heap_persistent_malloc("test", BOARD_heap_persistent_size) == NULL);
+	TEST(heap_persistent_get("test") == ptr);
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+	heap_free(ptr);
+	TEST(heap_persistent_get("test") == NULL);
+#endif
+	
+#if BOARD_heap_debug == TRUE
+	//the overrun is reported once, the bad frees are reported and refused, the live memory is reported as a leak
+	response_on_error		= rtos_response_on_error;
+	rtos_response_on_error	= test_on_error;
+	stats_counter			= heap_debug_report_leaks();
+	ptr						= heap_malloc(10);
+	ptr[10]					= 0x00;
+	test_err_code			= 0;
+	__heap_debug_check();
+	TEST((test_err_code & 0xFFFF0000) == __Err_DeviceSoftware_rtOS_HeapOverrun);
+	test_err_code			= 0;
+	__heap_debug_check();
+	TEST(test_err_code == 0);
+	heap_free(ptr + 1);
+	TEST((test_err_code & 0xFFFF0000) == __Err_DeviceSoftware_rtOS_HeapInvalidFree);
+	TEST(heap_debug_report_leaks() == stats_counter + 1);
+	TEST((test_err_code & 0xFFFF0000) == __Err_DeviceSoftware_rtOS_HeapLeak);
+	test_err_code			= 0;
+	heap_free(ptr);
+	TEST(test_err_code == 0);
+	heap_free(ptr);
+	TEST((test_err_code & 0xFFFF0000) == __Err_DeviceSoftware_rtOS_HeapDoubleFree);
+	TEST(heap_debug_report_leaks() == stats_counter);
+	mem_ptr[0]				= heap_pool_get(&test_pool);				//the block given back twice to the pool which is not full
+	mem_ptr[1]				= heap_pool_get(&test_pool);
+	heap_pool_put(&test_pool, mem_ptr[0]);
+	test_err_code			= 0;
+	heap_pool_put(&test_pool, mem_ptr[0]);
+	TEST((test_err_code & 0xFFFF0000) == __Err_DeviceSoftware_rtOS_HeapDoubleFree);
+	heap_pool_get_stats(&test_pool, &stats);
+	TEST(stats.free_bytes == 16);
+	heap_pool_put(&test_pool, mem_ptr[1]);
+	memset((void *)mem_ptr, 0, (MEM_PTR_SIZE * 2));
+	test_err_code			= 0;
+	ptr						= heap_malloc(BOARD_heap_single_block_size);	//the canary of the full block takes the next block
+	TEST(heap_get_size_of_free_memory() == free_mem_size - BOARD_heap_single_block_size * 2);
+	ptr[BOARD_heap_single_block_size] = 0x00;
+	heap_free(ptr);
+	TEST((test_err_code & 0xFFFF0000) == __Err_DeviceSoftware_rtOS_HeapOverrun);
+	test_err_code			= 0;
+	ptr						= heap_malloc(10);							//the memory without the canary, as the task handle
+	__heap_debug_disarm(ptr);
+	TEST(ptr[10] == 0x00);
+	ptr[10]					= 0xFF;
+	heap_free(ptr);
+	TEST(test_err_code == 0);
+	rtos_response_on_error	= response_on_error;
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+#endif
+	
+#if BOARD_heap_number_of_handles > 0
+	//the relocatable memory is moved down over the free blocks only while it is not locked
+	mem_ptr[0] = heap_malloc(TEST_heap_bytes(1));
+	handle = heap_handle_malloc(TEST_heap_bytes(2));
+	mem_ptr[1] = heap_malloc(TEST_heap_bytes(1));
+	ptr = heap_handle_lock(handle);
+	TEST(ptr == mem_ptr[0] + BOARD_heap_single_block_size);
+	ptr[0] = 0x77;
+	heap_free(mem_ptr[0]);
+	TEST(heap_compact() == 0);
+	heap_handle_unlock(handle);
+	TEST(heap_compact() == 1);
+	ptr = heap_handle_lock(handle);
+	TEST(ptr == mem_ptr[0]);
+	TEST(ptr[0] == 0x77);
+	heap_handle_unlock(handle);
+	heap_get_stats(&stats);
+	TEST(stats.largest_free_bytes == free_mem_size - BOARD_heap_single_block_size * 4);
+	heap_handle_free(handle);
+	TEST(heap_handle_lock(handle) == NULL);
+	heap_free(mem_ptr[1]);
+	memset((void *)mem_ptr, 0, (MEM_PTR_SIZE * 2));
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+	
+	//the handle follows the relocatable memory copied or moved down by heap_realloc()
+	mem_ptr[0] = heap_malloc(TEST_heap_bytes(1));
+	handle = heap_handle_malloc(TEST_heap_bytes(1));
+	mem_ptr[1] = heap_malloc(TEST_heap_bytes(1));
+	ptr = heap_handle_lock(handle);
+	ptr[0] = 0x55;
+	ptr = heap_realloc(ptr, TEST_heap_bytes(2));
+	TEST(ptr == mem_ptr[1] + BOARD_heap_single_block_size);
+	TEST(heap_handle_lock(handle) == ptr);
+	heap_handle_unlock(handle);
+	heap_handle_unlock(handle);
+	mem_ptr[2] = heap_malloc(TEST_heap_bytes(2));
+	heap_free(mem_ptr[1]);
+	ptr = heap_realloc(heap_handle_lock(handle), TEST_heap_bytes(4));
+	TEST(ptr == mem_ptr[0] + BOARD_heap_single_block_size);
+	TEST(heap_handle_lock(handle) == ptr);
+	TEST(ptr[0] == 0x55);
+	heap_handle_unlock(handle);
+	heap_handle_unlock(handle);
+	heap_handle_free(handle);
+	TEST(heap_handle_lock(handle) == NULL);
+	heap_free(mem_ptr[0]);
+	heap_free(mem_ptr[2]);
+	memset((void *)mem_ptr, 0, (MEM_PTR_SIZE * 2));
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+#endif
+	
+#if BOARD_heap_owner_tracking == TRUE
+	//the memory allocated by the task is freed with the task
+	test_rtos_add_task_to_scheduler(2, test_task_owner);
+	test_rtos_task_call(2, FALSE);
+	TEST(test_rtos_task_handle(2)->state == STOPPED);
+	TEST(heap_get_usage(test_rtos_task_handle(2)) == 0);
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+	
+	//the memory left by a freed task handle has no owner, a new task at the same address does not take it over
+	task_mem = heap_malloc(1);
+	__heap_set_owner(task_mem, test_rtos_task_handle(2));
+	TEST(heap_get_usage(test_rtos_task_handle(2)) == BOARD_heap_single_block_size);
+	__heap_clear_owner(test_rtos_task_handle(2));
+	TEST(heap_get_usage(test_rtos_task_handle(2)) == 0);
+	heap_free(task_mem);
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+#endif
 	
-	//check memory allocation via task interface
+	//check memory allocation via task interface, the task waits once
+	heap_get_stats(&stats);
+	stats_counter = stats.waits;
 	check_task_malloc();
+	heap_get_stats(&stats);
+	TEST(stats.waits == stats_counter + 1);
+	check_task_malloc_queue();
 	
 	malloc_all_memory();
 	free_memory(0);
@@ -141,15 +455,15 @@ void heap_test(void)
 	
 	free_memory(7);
 	free_memory(8);
-	TEST(heap_malloc(BOARD_heap_single_block_size*5) == NULL);
+	TEST(heap_malloc(TEST_heap_bytes(5)) == NULL);
 	
 	ptr = mem_ptr[6];
 	free_memory(2);
 	free_memory(6);
-	TEST(heap_malloc(BOARD_heap_single_block_size*5) == NULL);
+	TEST(heap_malloc(TEST_heap_bytes(5)) == NULL);
 
 	free_memory(9);
-	TEST(heap_malloc(BOARD_heap_single_block_size*5) == ptr);
+	TEST(heap_malloc(TEST_heap_bytes(5)) == ptr);
 	
 	heap_free(ptr);	
 	free_memory(4);
@@ -102,15 +102,10 @@ void test_rtos_remove_task_from_scheduler(uint8_t task_id)
 		task_handle_t *task = &test_tasks[task_id];
 	
 		if(task->next_task != NULL){
-			if(__task_ready_g == task){
-				__task_ready_g = task->next_task;
+			task_freeze(STOPPED, task);
+			if(__task_ready_g){
 				__task_ready_g->state = RUNNING;
 			}
-			(task->next_task)->prev_task = task->prev_task;
-			(task->prev_task)->next_task = task->next_task;
-			task->next_task = NULL;
-			task->prev_task = NULL;
-			task->state = STOPPED;
 		}
 	}
 }
@@ -144,7 +139,7 @@ static void test_idle_task(void)
  *			any_irq_pending == TRUE -> run mode
  *
  *			any_peripheral		tasks_in_scheduler
- *				FALSE				FALSE				-> SLEEP_MODE_EXT_STANDBY
+ *				FALSE				FALSE				-> SLEEP_MODE_EXT_STANDBY (SLEEP_MODE_PWR_SAVE if BOARD_tickless_idle == TRUE)
  *				TRUE				FALSE				-> SLEEP_MODE_IDLE
  *				FALSE				TRUE				-> run mode
  *				TRUE				TRUE				-> run mode
@@ -164,7 +159,11 @@ void check_sleep_mode(void)
 	test_rtos_peripherals_off();
 	test_rtos_irq_reset();
 	idle_task();
+#if BOARD_tickless_idle == TRUE
+	TEST(sleep_mode == SLEEP_MODE_PWR_SAVE);
+#else
 	TEST(sleep_mode == SLEEP_MODE_EXT_STANDBY);
+#endif
 
 /*			any_peripheral		tasks_in_scheduler
 *				TRUE				FALSE				-> SLEEP_MODE_IDLE
@@ -333,8 +332,14 @@ void init_tests(void)
 	event_test();
 
 /****** HEAP FILE ******/
+#ifdef RUN_HEAP_BENCH
+	heap_bench();
+#endif
 	heap_test();
 	
+/****** SLAB FILE ******/
+	slab_test();
+	
 /****** SEMAPHORE FILE ******/
 	semaphore_test();
 
@@ -24,6 +24,13 @@ static void test_task_mutex(void)
 	condWait_mutex_lock(&sem);
 }
 
+#if BOARD_task_timeouts == TRUE
+static void test_task_semaphore_timeout(void)
+{
+	condWait_semaphore_wait_timeout(&sem, 10);
+}
+#endif
+
 
 void semaphore_test(void)
 {
@@ -112,9 +119,83 @@ void semaphore_test(void)
 	TEST(mutex_is_pending_list_empty(&sem) == FALSE);
 	mutex_remove_from_pending_list(test_rtos_task_handle(0), &sem);
 	TEST(mutex_is_pending_list_empty(&sem) == TRUE);
+	
+	//the owner runs with the priority of the waiting task until it unlocks the mutex
+	task_set_priority(TASK_priority_highest, test_rtos_task_handle(0));
+	test_rtos_task_call(0, TRUE);
+	TEST(task_get_priority(test_rtos_task_handle(1)) == TASK_priority_highest);
+	mutex_remove_from_pending_list(test_rtos_task_handle(0), &sem);
+	TEST(task_get_priority(test_rtos_task_handle(1)) == TASK_priority_default);
+	
+	test_rtos_task_call(0, TRUE);
+	task_set_priority(TASK_priority_idle, test_rtos_task_handle(1));				//the inherited priority is kept
+	TEST(task_get_priority(test_rtos_task_handle(1)) == TASK_priority_highest);
+	test_rtos_set_as_current_running_task(1);
+	TEST(mutex_unlock(&sem) == 0);
+	TEST(task_get_priority(test_rtos_task_handle(1)) == TASK_priority_idle);
+	TEST(sem.owner == test_rtos_task_handle(0));
+	TEST(task_get_priority(test_rtos_task_handle(0)) == TASK_priority_highest);
+	test_rtos_set_as_current_running_task(0);
+	TEST(mutex_unlock(&sem) == 0);
+	task_set_priority(TASK_priority_default, test_rtos_task_handle(0));
+	task_set_priority(TASK_priority_default, test_rtos_task_handle(1));
+	
+	//the mutex is handed to the waiting task with the highest priority, not to the first one
+	test_rtos_task_call(0, TRUE);
+	test_rtos_task_call(1, TRUE);
+	test_rtos_add_task_to_scheduler(2, test_task_mutex);
+	task_set_priority(TASK_priority_highest, test_rtos_task_handle(2));
+	test_rtos_task_call(2, TRUE);
+	TEST(sem.owner == test_rtos_task_handle(0));
+	TEST(task_get_priority(test_rtos_task_handle(0)) == TASK_priority_highest);
+	test_rtos_set_as_current_running_task(0);
+	TEST(mutex_unlock(&sem) == 0);
+	TEST(task_get_priority(test_rtos_task_handle(0)) == TASK_priority_default);
+	TEST(sem.owner == test_rtos_task_handle(2));
+	test_rtos_set_as_current_running_task(2);
+	TEST(mutex_unlock(&sem) == 0);
+	TEST(sem.owner == test_rtos_task_handle(1));
+	test_rtos_set_as_current_running_task(1);
+	TEST(mutex_unlock(&sem) == 0);
+	TEST(sem.owner == NULL);
+	task_set_priority(TASK_priority_default, test_rtos_task_handle(2));
 
 	test_rtos_remove_task_from_scheduler(0);
 	test_rtos_remove_task_from_scheduler(1);
+	test_rtos_remove_task_from_scheduler(2);
+	
+#if BOARD_task_timeouts == TRUE
+	/****** TIMEOUT ******/
+	//the task is in the pending list and in the list of timeouts, the time runs out first
+	semaphore_init(&sem, 1, 0);
+	test_rtos_add_task_to_scheduler(0, test_task_semaphore_timeout);
+	test_rtos_task_call(0, FALSE);
+	TEST(test_rtos_task_handle(0)->state == WAIT_SEMA);
+	TEST(__task_get_nearest_wakeup() != 0xFFFF);
+	__task_refresh_delayed(__task_get_nearest_wakeup());	//normally this function will be called by the scheduler
+	TEST(test_rtos_task_handle(0)->state == READY);
+	TEST(test_rtos_task_handle(0)->timeout.time == TASK_timeout_expired);
+	TEST(semaphore_is_pending_list_empty(&sem) == TRUE);
+	TEST(__task_get_nearest_wakeup() == 0xFFFF);
+	
+	//the semaphore is signalled first, the timeout is removed
+	test_rtos_task_call(0, TRUE);
+	TEST(test_rtos_task_handle(0)->state == WAIT_SEMA);
+	semaphore_signal(&sem);
+	TEST(test_rtos_task_handle(0)->state == READY);
+	TEST(test_rtos_task_handle(0)->timeout.time == 0);
+	TEST(__task_get_nearest_wakeup() == 0xFFFF);
+	
+	//the task removed from the pending list is not woken up by its timeout
+	test_rtos_task_call(0, TRUE);
+	TEST(__task_get_nearest_wakeup() != 0xFFFF);
+	semaphore_remove_from_pending_list(test_rtos_task_handle(0), &sem);
+	TEST(test_rtos_task_handle(0)->state == SLEEP_INFINITE);
+	TEST(__task_get_nearest_wakeup() == 0xFFFF);
+	task_start(test_rtos_task_handle(0));
+	
+	test_rtos_remove_task_from_scheduler(0);
+#endif
 }
 
 #endif
@@ -0,0 +1,81 @@
+/*
+ * slab_test.c
+ */ 
+#ifdef RUN_TESTS
+#include <avr/io.h>
+#include <string.h>
+#include <avr/interrupt.h>
+#include "test.h"
+#include "rtos.h"
+
+#define TEST_slab_block_bytes	(BOARD_heap_single_block_size + ((HEAP_debug_canary_size > 0) ? BOARD_heap_single_block_size : 0))	//the canary of the slab block takes one more heap block in the debug mode
+
+void slab_test(void)
+{
+#if BOARD_include_slab == TRUE
+	uint16_t free_mem_size = heap_get_size_of_free_memory();
+	uint8_t *mem_ptr[5], *ptr;
+	slab_stats_t stats;
+	
+	TEST(slab_malloc(0) == NULL);
+	TEST(slab_get_stats(12, &stats) == FALSE);		//there is no such class
+	
+	//the small objects share one heap block
+	mem_ptr[0] = slab_malloc(5);
+	TEST(mem_ptr[0] != NULL);
+	TEST(heap_get_size_of_free_memory() == free_mem_size - TEST_slab_block_bytes);
+	
+	for(uint8_t i=1; i<(BOARD_heap_single_block_size / 8); i++){
+		ptr = slab_malloc(8);
+		TEST(ptr == mem_ptr[0] + 8*i);
+		TEST(heap_get_size_of_free_memory() == free_mem_size - TEST_slab_block_bytes);
+		if(i < 4)mem_ptr[i] = ptr;
+	}
+	TEST(slab_get_stats(8, &stats) == TRUE);
+	TEST(stats.blocks == 1);
+	TEST(stats.used == BOARD_heap_single_block_size / 8);
+	TEST(stats.free == 0);
+	
+	//the next heap block is taken when the class is full
+	mem_ptr[4] = slab_malloc(1);
+	TEST(mem_ptr[4] != NULL);
+	TEST(heap_get_size_of_free_memory() == free_mem_size - 2*TEST_slab_block_bytes);
+	
+	//the freed object is reused at once
+	ptr = mem_ptr[1];
+	slab_free(mem_ptr[1]);
+	mem_ptr[1] = slab_malloc(8);
+	TEST(mem_ptr[1] == ptr);
+	TEST(*mem_ptr[1] == 0);							//the memory is cleared
+	
+	//the heap blocks are given back when all their objects are freed
+	slab_free(mem_ptr[4]);
+	TEST(heap_get_size_of_free_memory() == free_mem_size - TEST_slab_block_bytes);
+	for(uint8_t i=0; i<(BOARD_heap_single_block_size / 8); i++){
+		slab_free(mem_ptr[0] + 8*i);
+	}
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+	TEST(slab_get_stats(8, &stats) == TRUE);
+	TEST(stats.blocks == 0);
+	TEST(stats.used == 0);
+	TEST(stats.free == 0);
+	TEST(stats.peak_used == BOARD_heap_single_block_size / 8 + 1);
+	
+	//the 16 bytes class
+	ptr = slab_malloc(9);
+	TEST(slab_get_stats(16, &stats) == TRUE);
+	TEST(stats.used == 1);
+	TEST(stats.free == BOARD_heap_single_block_size / 16 - 1);
+	slab_free(ptr);
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+	
+	//the large requests are passed to the heap
+	ptr = slab_malloc(BOARD_heap_single_block_size + 1);
+	TEST(ptr != NULL);
+	TEST(heap_get_size_of_free_memory() == free_mem_size - 2*BOARD_heap_single_block_size);
+	slab_free(ptr);
+	TEST(heap_get_size_of_free_memory() == free_mem_size);
+#endif
+}
+
+#endif
@@ -13,6 +13,7 @@
 
 
 extern task_handle_t *__task_ready_g;
+extern task_handle_t __idle_task;
 
 
 static task_handle_t *task_list;
@@ -78,6 +79,18 @@ static void test_task_delay(void)
 	condWait_task_delay(TEST_TASK_SLEEP_TIME);
 }
 
+static uint32_t test_task_last_wake;
+
+static void test_task_delay_until(void)
+{
+	condWait_task_delay_until(&test_task_last_wake, TEST_TASK_SLEEP_TIME);
+}
+
+static void test_task_delay_long(void)
+{
+	condWait_task_delay(3*TEST_TASK_SLEEP_TIME);
+}
+
 /***************** join *******************/
 #define TEST_TASK_JOIN_JOIN_CHILD								0
 #define TEST_TASK_JOIN_STOP_CHILD								1
@@ -136,6 +149,8 @@ void task_test(void)
 	
 	uint8_t *temp;
 	task_handle_t *task_ptr_1;
+	uint16_t wake_up_time;
+	uint32_t system_time;
 	
 	/****** POP AND PUSH LIST ******/
 	//push front
@@ -155,6 +170,12 @@ void task_test(void)
 	task_list_remove_by_item(&task_list, test_rtos_task_handle(1));
 	TEST(test_rtos_task_handle(0)->prev_task == test_rtos_task_handle(2));
 	TEST(test_rtos_task_handle(2)->next_task == test_rtos_task_handle(0));
+	task_list_remove_by_item(&task_list, test_rtos_task_handle(1));		//the item out of the list is not removed again
+	TEST(test_rtos_task_handle(2)->next_task == test_rtos_task_handle(0));
+	task_list_remove_by_item(&task_list, test_rtos_task_handle(TEST_NUMBER_OF_TASKS-1));
+	TEST(task_list == test_rtos_task_handle(TEST_NUMBER_OF_TASKS-2));
+	TEST(task_list->prev_task == NULL);
+	task_list_push_front(&task_list, test_rtos_task_handle(TEST_NUMBER_OF_TASKS-1));
 	
 	//pop back
 	TEST(task_list_pop_back(&task_list) == test_rtos_task_handle(0));
@@ -182,9 +203,28 @@ void task_test(void)
 	}
 	TEST(task_list == NULL);
 	
+	//the queue keeps the last item in the prev_task of the first one
+	for(uint8_t i = 0; i<TEST_NUMBER_OF_TASKS; i++){
+		task_queue_push_back(&task_list, test_rtos_task_handle(i));
+		TEST(task_list->prev_task == test_rtos_task_handle(i));
+	}
+	TEST(test_rtos_task_handle(TEST_NUMBER_OF_TASKS-1)->next_task == NULL);
+	task_queue_remove_by_item(&task_list, test_rtos_task_handle(TEST_NUMBER_OF_TASKS-1));
+	TEST(task_list->prev_task == test_rtos_task_handle(TEST_NUMBER_OF_TASKS-2));
+	task_queue_remove_by_item(&task_list, test_rtos_task_handle(1));
+	TEST(test_rtos_task_handle(0)->next_task == test_rtos_task_handle(2));
+	TEST(test_rtos_task_handle(2)->prev_task == test_rtos_task_handle(0));
+	TEST(task_queue_pop_front(&task_list) == test_rtos_task_handle(0));
+	TEST(task_list->prev_task == test_rtos_task_handle(TEST_NUMBER_OF_TASKS-2));
+	for(uint8_t i = 2; i<TEST_NUMBER_OF_TASKS-1; i++){
+		TEST(task_queue_pop_front(&task_list) == test_rtos_task_handle(i));
+		TEST(test_rtos_task_handle(i)->prev_task == NULL);
+	}
+	TEST(task_list == NULL);
+	
 	/****** TASK OPERATION ******/
 	//new task
-	temp = heap_malloc(BOARD_heap_single_block_size*BOARD_heap_number_of_blocks); //allocate all free memory
+	temp = heap_malloc(BOARD_heap_single_block_size*BOARD_heap_number_of_blocks - HEAP_debug_canary_size); //allocate all free memory
 	task_new_dynamic = task_new(test_task_create_new);
 	TEST(task_new_dynamic == NULL);		//should be null, no free memory
 	heap_free(temp);
@@ -200,7 +240,7 @@ void task_test(void)
 	task_start(task_ptr_1);
 	TEST(task_ptr_1->code_addr == (uint16_t)test_task_create_new);
 	TEST(task_ptr_1->state == READY);
-	temp = heap_malloc(BOARD_heap_single_block_size*BOARD_heap_number_of_blocks); //allocate all free memory
+	temp = heap_malloc(BOARD_heap_single_block_size*BOARD_heap_number_of_blocks - HEAP_debug_canary_size); //allocate all free memory
 	CALL_TASK(task_ptr_1);		//call task function
 	TEST(task_new_dynamic == NULL);
 	TEST(task_ptr_1->state == WAIT_SEMA);
@@ -229,20 +269,90 @@ void task_test(void)
 	TEST(task_ptr_1->state == READY);						//now the task should be READY
 	TEST(task_check_if_any_is_waiting_for_irq() == FALSE);
 	task_delete(task_ptr_1);
+	
+	//one report wakes up every task waiting for the interrupt, the interrupts nobody waits for stay reported
+	for(uint8_t i=0; i<3; i++){
+		task_setup(test_rtos_task_handle(i), test_task_wait_for_irq);
+		task_start(test_rtos_task_handle(i));
+		CALL_TASK(test_rtos_task_handle(i));
+	}
+	rtos_irq_report(_IrqINT0);
+	rtos_irq_report(_IrqINT1);
+	__task_refresh_interrupted();
+	for(uint8_t i=0; i<3; i++){
+		TEST(test_rtos_task_handle(i)->state == READY);
+		TEST(test_rtos_task_handle(i)->sleep_irq_num == 0);
+	}
+	TEST(task_check_if_any_is_waiting_for_irq() == FALSE);
+	TEST(rtos_irq_get(_IrqINT1) == FALSE);					//consumed by the scheduler
+	TEST(rtos_irq_get(_IrqINT0) == TRUE);					//nobody has been waiting for it
+	for(uint8_t i=0; i<3; i++){
+		task_delete(test_rtos_task_handle(i));
+	}
 
 	//delay task
 	task_ptr_1 = test_rtos_task_handle(0);	//get task handle from test tasks array
 	task_setup(task_ptr_1, test_task_delay);
 	task_start(task_ptr_1);
+	TEST(__task_get_nearest_wakeup() == 0xFFFF);				//no task is sleeping
 	CALL_TASK(task_ptr_1);
 	TEST(task_ptr_1->state == SLEEP_TIMED);					//the state should be SLEEP_TIMED	
+	TEST(__task_get_nearest_wakeup() == task_ptr_1->sleep_time);
 	__task_refresh_delayed(TEST_TASK_SLEEP_TIME/2);			//normally this function will be called by the scheduler
 	TEST(task_ptr_1->state == SLEEP_TIMED);					//the state should be still SLEEP_TIMED
 	TEST(task_ptr_1->sleep_time < TEST_TASK_SLEEP_TIME);
 	__task_refresh_delayed(TEST_TASK_SLEEP_TIME/2 + 1);		//normally this function will be called by the scheduler
 	TEST(task_ptr_1->state == READY);						//now the task should be READY
+	TEST(__task_get_nearest_wakeup() == 0xFFFF);
 	task_delete(task_ptr_1);
 	
+	//delay until the absolute wake up time, the lateness of the task is not added to the period
+	task_setup(task_ptr_1, test_task_delay_until);
+	task_start(task_ptr_1);
+	cli();
+	__timer_clear_time_ms();
+	system_time = rtos_get_system_time_ms();
+	test_task_last_wake = system_time - 3;					//the task is 3 ticks late
+	CALL_TASK(task_ptr_1);
+	sei();
+	TEST(task_ptr_1->state == SLEEP_TIMED);
+	TEST(task_ptr_1->sleep_time == TEST_TASK_SLEEP_TIME - 3);
+	TEST(test_task_last_wake == system_time + TEST_TASK_SLEEP_TIME - 3);
+	__task_refresh_delayed(TEST_TASK_SLEEP_TIME - 3);
+	TEST(task_ptr_1->state == READY);
+	test_task_last_wake -= 2*TEST_TASK_SLEEP_TIME;			//the wake up time has been missed
+	CALL_TASK(task_ptr_1);
+	TEST(task_ptr_1->state != SLEEP_TIMED);					//the task only gives up the CPU
+	TEST(__task_get_nearest_wakeup() == 0xFFFF);
+	task_delete(task_ptr_1);
+	
+	//sleeping tasks are sorted by the wake up time, each task keeps the time relative to the previous one
+	task_setup(test_rtos_task_handle(0), test_task_delay_long);
+	task_setup(test_rtos_task_handle(1), test_task_delay);
+	task_setup(test_rtos_task_handle(2), test_task_delay);
+	for(uint8_t i=0; i<3; i++){
+		task_start(test_rtos_task_handle(i));
+		CALL_TASK(test_rtos_task_handle(i));
+	}
+	TEST(test_rtos_task_handle(1)->next_task == test_rtos_task_handle(2));	//the same wake up time, the order of calls is kept
+	TEST(test_rtos_task_handle(2)->sleep_time == 0);
+	TEST(test_rtos_task_handle(2)->next_task == test_rtos_task_handle(0));
+	TEST(test_rtos_task_handle(0)->sleep_time == 2*TEST_TASK_SLEEP_TIME);
+	TEST(__task_get_nearest_wakeup() == test_rtos_task_handle(1)->sleep_time);
+	wake_up_time = __task_get_nearest_wakeup();
+	task_delete(test_rtos_task_handle(1));				//the rest of the time should be passed to the next task
+	TEST(__task_get_nearest_wakeup() == wake_up_time);
+	TEST(test_rtos_task_handle(2)->prev_task == NULL);
+	__task_refresh_delayed(wake_up_time + 1);
+	TEST(test_rtos_task_handle(2)->state == READY);
+	TEST(test_rtos_task_handle(0)->state == SLEEP_TIMED);
+	TEST(test_rtos_task_handle(0)->sleep_time == 2*TEST_TASK_SLEEP_TIME - 1);
+	__task_refresh_delayed(2*TEST_TASK_SLEEP_TIME - 1);
+	TEST(test_rtos_task_handle(0)->state == READY);
+	TEST(__task_get_nearest_wakeup() == 0xFFFF);
+	task_delete(test_rtos_task_handle(0));
+	task_delete(test_rtos_task_handle(2));
+	
 	//task join
 	for(uint8_t i=0; i<5; i++){
 		task_setup(test_rtos_task_handle(i), test_task_join_child);
@@ -312,7 +422,57 @@ void task_test(void)
 	
 	for(uint8_t i=0; i<TEST_NUMBER_OF_TASKS; i++)
 		test_rtos_remove_task_from_scheduler(i);
+		
+	/****** PRIORITIES ******/
+#if BOARD_task_number_of_priorities > 2
+	//the setup does not take over the priority and the mutexes left in the handle
+	test_rtos_task_handle(0)->priority			= TASK_priority_highest;
+	test_rtos_task_handle(0)->base_priority		= TASK_priority_highest;
+	test_rtos_task_handle(0)->head_mutexes_list	= (semaphore_t *)test_rtos_task_handle(1);
+	
+	for(uint8_t i=0; i<3; i++){
+		task_setup(test_rtos_task_handle(i), test_task_delay);
+		TEST(task_get_priority(test_rtos_task_handle(i)) == TASK_priority_default);
+		TEST(test_rtos_task_handle(i)->base_priority == TASK_priority_default);
+		TEST(task_get_first_mutex_from_list(test_rtos_task_handle(i)) == NULL);
+	}
+	task_set_priority(TASK_priority_highest + 1, test_rtos_task_handle(2));	//the priority should be limited to the highest one
+	TEST(task_get_priority(test_rtos_task_handle(2)) == TASK_priority_highest);
+	
+	for(uint8_t i=0; i<3; i++){
+		task_start(test_rtos_task_handle(i));
+	}
+	TEST(task_get_number_of_running_tasks() == 4);		//three test tasks and the idle task
+	__task_switch();
+	TEST(task_this() == test_rtos_task_handle(2));		//the task with the highest priority should be always chosen
+	__task_switch();
+	TEST(task_this() == test_rtos_task_handle(2));
+	task_freeze(SLEEP_INFINITE, test_rtos_task_handle(2));
+	TEST(task_ready_count() == 3);						//the count follows the freeze without walking the lists
+	TEST(task_get_priority() == TASK_priority_default);	//the current task should be taken over by the lower priority level
+	
+	__task_switch();
+	task_ptr_1 = task_this();
+	TEST( (task_ptr_1 == test_rtos_task_handle(0)) || (task_ptr_1 == test_rtos_task_handle(1)) );
+	__task_switch();
+	TEST(task_this() != task_ptr_1);					//tasks with the same priority should be run in turn
+	TEST(task_get_priority() == TASK_priority_default);
+	__task_switch();
+	TEST(task_this() == task_ptr_1);
+	
+	//change the priority of a ready task
+	task_set_priority(TASK_priority_idle, test_rtos_task_handle(0));
+	task_set_priority(TASK_priority_idle, test_rtos_task_handle(1));
+	TEST(task_get_number_of_running_tasks() == 3);
+	__task_switch();
+	TEST(task_get_priority() == TASK_priority_idle);	//now all tasks share the idle task priority
+	
+	for(uint8_t i=0; i<3; i++){
+		test_rtos_remove_task_from_scheduler(i);
+	}
+	TEST(task_get_number_of_running_tasks() == 1);		//only the idle task should be left
+	TEST(task_this() == &__idle_task);
+#endif
 }
 
 #endif
-
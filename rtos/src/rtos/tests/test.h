@@ -78,10 +78,15 @@ void test_rtos_task_call(uint8_t task_id, uint8_t reset_pc);
 
 void event_test(void);
 void heap_test(void);
+void slab_test(void);
 void semaphore_test(void);
 void task_test(void);
 void timers_test(void);
 
+#ifdef RUN_HEAP_BENCH
+void heap_bench(void);
+#endif
+
 
 
 
@@ -12,7 +12,7 @@
 #include "rtos.h"
 
 static timer_handle_t t1, t2, t3;
-static uint8_t t2_timer_reset, t3_timer_reset;
+static uint8_t t2_timer_reset, t3_timer_reset, t1_periodic_cnt;
 
 //notify function
 void timer_t2_notify(void)
@@ -21,6 +21,14 @@ void timer_t2_notify(void)
 	timer_start_notify_function(&t2, 0x2E624, timer_t2_notify);
 }
 
+//periodic notify function, stops the timer after 5 periods
+void timer_t1_periodic_notify(void)
+{
+	if(++t1_periodic_cnt == 5){
+		timer_stop(&t1);
+	}
+}
+
 //notify task
 __attribute__((noinline))void task_timer(void)
 {
@@ -38,6 +46,10 @@ __attribute__((noinline))void task_timer(void)
 void timers_test(void)
 {
 	uint32_t time1, time2, time3;
+	
+	timer_init(&t1);
+	timer_init(&t2);
+	timer_init(&t3);
 	//check time to clock ticks change
 	TEST(__timer_ms_to_ticks_16bits(1) == 1);
 	TEST(__timer_ms_to_ticks_16bits(8) == 8);
@@ -50,16 +62,16 @@ void timers_test(void)
 	
 	//check timer counter settings
 	timer_start(&t1, 58542);
-	TEST(t1.TCNT == 58131);
+	TEST(timer_get_time(&t1) == 58131);
 	
 	timer_start(&t1, 2162687832);
-	TEST(t1.TCNT == 2147483647);
+	TEST(timer_get_time(&t1) == 2147483647);
 	
 	timer_start(&t1, 1000000000);
-	TEST(t1.TCNT == 992969698);
+	TEST(timer_get_time(&t1) == 992969698);
 	
 	timer_start(&t1, 463129181);
-	TEST(t1.TCNT == 459873244);
+	TEST(timer_get_time(&t1) == 459873244);
 	
 	time1 = 0x1E625;
 	time2 = 0x2E624;
@@ -70,9 +82,10 @@ void timers_test(void)
 	test_rtos_add_task_to_scheduler(0, task_timer);
 	test_rtos_task_call(0, FALSE);
 	
-	time1 = t1.TCNT;
-	time2 = t2.TCNT;
-	time3 = t3.TCNT;
+	time1 = timer_get_time(&t1);
+	time2 = timer_get_time(&t2);
+	time3 = timer_get_time(&t3);
+	TEST(__timer_get_nearest_expiry() == time1);	//t1 has the shortest time
 	
 	for(uint8_t i=0; i<6; i++){
 		__timer_refresh_timers(13000);
@@ -109,7 +122,67 @@ void timers_test(void)
 	TEST(t2_timer_reset == TRUE);
 	timer_stop(&t2);
 	TEST(timer_get_time(&t2) == 0);
+	TEST(__timer_get_nearest_expiry() == 0x7FFFFFFF);	//no timer is counting down
+	
+	//check the exact expiry time
+	timer_start(&t1, 1000);
+	time1 = timer_get_time(&t1);
+	__timer_refresh_timers(time1 - 1);
+	TEST(timer_get_time(&t1) == 1);
+	__timer_refresh_timers(1);
+	TEST(timer_get_time(&t1) == 0);
+	
+	//check the long countdowns and stopping the timer in the middle of the countdown
+	timer_start(&t1, 300000);
+	timer_start(&t2, 70000);
+	time1 = timer_get_time(&t1);
+	time2 = timer_get_time(&t2);
+	for(uint8_t i=0; i<4; i++){
+		__timer_refresh_timers(60000);
+		time1 -= 60000;
+		time2 -= (time2 > 60000) ? 60000 : time2;
+		TEST(timer_get_time(&t1) == time1);
+		TEST(timer_get_time(&t2) == time2);
+		if(i == 0){
+			TEST(__timer_get_nearest_expiry() == time2);
+			timer_start(&t2, 70000);
+			time2 = timer_get_time(&t2);
+		}
+	}
+	timer_stop(&t1);
+	TEST(timer_get_time(&t1) == 0);
+	TEST(__timer_get_nearest_expiry() == 0x7FFFFFFF);
+	__timer_refresh_timers(time1);
+	TEST(timer_get_time(&t1) == 0);
+	
+	//check the periodic timer, it is reloaded from the expiry time
+	timer_start_periodic_notify_function(&t1, 100, timer_t1_periodic_notify);
+	TEST(t1.period == __timer_ms_to_ticks_32bits(100));
+	time1 = timer_get_time(&t1);
+	__timer_refresh_timers(time1 + 10);				//the listener has been late 10 ticks
+	TEST(t1_periodic_cnt == 1);
+	TEST(timer_get_time(&t1) == t1.period - 10);
+	for(uint8_t i=0; i<3; i++){
+		__timer_refresh_timers(t1.period);
+	}
+	TEST(t1_periodic_cnt == 4);
+	TEST(timer_get_time(&t1) == t1.period - 10);	//no drift
+	__timer_refresh_timers(t1.period);
+	TEST(t1_periodic_cnt == 5);
+	TEST(timer_get_time(&t1) == 0);					//stopped by the notify function
+	__timer_refresh_timers(t1.period);
+	TEST(t1_periodic_cnt == 5);
 	
+#if BOARD_tickless_idle == TRUE
+	//stretch the system timer period
+	cli();
+	__timer_clear_time_ms();
+	TEST(__timer_tickless_enter(1) == FALSE);		//the deadline is too close
+	TEST(__timer_tickless_enter(100) == TRUE);
+	__timer_tickless_exit();
+	TEST(__timer_get_time_ms() == 0);				//no time has elapsed in the test environment
+	sei();
+#endif
 }
 
 
@@ -6,16 +6,24 @@
  */ 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <string.h>
 #include "rtos.h"
 
 
 
-#if BOARD_include_timers == TRUE
+#if (BOARD_include_timers == TRUE) && (BOARD_timers_timing_wheel != TRUE)
 static volatile	timer_handle_t	*volatile __timer_timers;
 #endif
 
 static volatile	uint16_t		__timer_system_time;
 
+#if BOARD_tickless_idle == TRUE
+static volatile	uint8_t			__timer_tickless_prescaler;		//prescaler index + 1 while the system timer is stretched, otherwise 0
+static volatile	uint8_t			__timer_tickless_fired;			//the stretched period has ended
+static			uint8_t			__timer_tickless_ocr;
+static			uint8_t			__timer_tickless_rest;			//counts of the last tick which were not credited before sleep
+#endif
+
 
 /**********************************************************************************************//**
  * @fn	ISR(RTOS_peripheral_system_timer_vect)
@@ -26,6 +34,12 @@ static volatile	uint16_t		__timer_system_time;
 
 ISR(RTOS_peripheral_system_timer_vect)
 {
+#if BOARD_tickless_idle == TRUE
+	if(__timer_tickless_prescaler){
+		__timer_tickless_fired = TRUE;		//the elapsed time will be credited by __timer_tickless_exit
+		return;
+	}
+#endif
 	__timer_system_time++;
 }
 
@@ -125,25 +139,135 @@ void __timer_clear_time_ms(void)
 }
 
 
+#if BOARD_tickless_idle == TRUE
+
+/**********************************************************************************************//**
+ * @fn	uint8_t __timer_tickless_enter(uint32_t deadline)
+ *
+ * @brief	the function stretches the system timer period so the CPU can sleep until the given deadline
+ *			without waking up every tick, you must disable the global interrupt before calling this function
+ *			and call __timer_tickless_exit just after waking up.
+ *
+ * @param	deadline	the nearest deadline in ticks counted in the same way as the ms counter
+ *
+ * @returns	uint8_t		TRUE - the system timer has been stretched
+ *						FALSE - the deadline is too close or the tick interrupt is pending
+ **************************************************************************************************/
+
+uint8_t __timer_tickless_enter(uint32_t deadline)
+{
+#ifndef RUN_SIMULATOR
+	uint16_t time = __timer_system_time;
+	uint8_t prescaler = 0;
+	uint32_t counts;
+	
+	if(__rtos_peripheral_system_timer_clear_irq() == TRUE){	//the pending tick must be counted before the timer period is changed
+		__timer_system_time++;
+		return FALSE;
+	}
+	if(deadline <= (uint32_t)time + 1)return FALSE;
+	
+	deadline -= time;
+	if(deadline > RTOS_peripheral_system_clock_max_sleep_ticks){
+		deadline = RTOS_peripheral_system_clock_max_sleep_ticks;
+	}
+	__timer_tickless_rest = __rtos_peripheral_system_timer_get_counter();
+	counts = deadline * (RTOS_peripheral_system_clock_OCRA + 1) - __timer_tickless_rest;
+	
+	while((counts >> RTOS_peripheral_system_clock_prescaler_shift(prescaler)) > 256){
+		prescaler++;
+	}
+	__timer_tickless_ocr		= (uint8_t)((counts >> RTOS_peripheral_system_clock_prescaler_shift(prescaler)) - 1);
+	__timer_tickless_fired		= FALSE;
+	__timer_tickless_prescaler	= prescaler + 1;
+	__rtos_peripheral_system_timer_setup(prescaler, __timer_tickless_ocr, 0);
+	
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void __timer_tickless_exit(void)
+ *
+ * @brief	the function credits the time spent in sleep to the ms counter and restores the system timer period,
+ *			you must disable the global interrupt before calling this function
+ *
+ **************************************************************************************************/
+
+void __timer_tickless_exit(void)
+{
+	if(__timer_tickless_prescaler == 0)return;
+	
+	uint8_t shift = RTOS_peripheral_system_clock_prescaler_shift(__timer_tickless_prescaler - 1);
+	uint8_t fired = (__timer_tickless_fired || __rtos_peripheral_system_timer_clear_irq()) ? TRUE : FALSE;
+	uint8_t counter = __rtos_peripheral_system_timer_get_counter();
+	uint32_t counts;
+	
+	if( (fired == FALSE) && (__rtos_peripheral_system_timer_clear_irq() == TRUE) ){	//the period has ended while reading the counter
+		fired	= TRUE;
+		counter	= __rtos_peripheral_system_timer_get_counter();
+	}
+	counts = ((uint32_t)counter << shift) + __timer_tickless_rest;
+	
+	if(fired){
+		counts += ((uint32_t)__timer_tickless_ocr + 1) << shift;
+	}
+	__timer_system_time			+= (uint16_t)(counts / (RTOS_peripheral_system_clock_OCRA + 1));
+	__timer_tickless_prescaler	= 0;
+	__rtos_peripheral_system_timer_setup(0, RTOS_peripheral_system_clock_OCRA, (uint8_t)(counts % (RTOS_peripheral_system_clock_OCRA + 1)));
+}
+
+#endif
+
+
 #if BOARD_include_timers == TRUE
 
 /**********************************************************************************************//**
- * @fn	void __timer_start_timer(timer_handle_t *timer, uint32_t tcnt, task_handle_t *listener, void (*notify_f)(void))
+ * @fn	static void __timer_notify(timer_handle_t *timer)
  *
- * @brief	Used by the system to start the timer. After the time has elapsed the timer can wake up the task or trigger a given function 
+ * @brief	Used by the system to wake up the task owning the timer or to trigger its notification function
  *
- * @param 	timer   	If non-null, the timer to run.
+ * @param 	timer		the timer which has stopped counting down.
+ **************************************************************************************************/
+
+static void __timer_notify(timer_handle_t *timer)
+{
+	if(timer->timer_owner != NULL){
+		if(timer->n == __TIMER_WITH_NOTIFY){
+			timer->timer_notify_f();
+			
+		}else{
+			task_state_t task_state = task_get_state(timer->timer_owner);
+			
+			if( (task_state == STOPPED) ||
+				(task_state == SLEEP_INFINITE) ||
+				(task_state == SLEEP_TIMED) )
+			{
+				task_unfreeze(timer->timer_owner);
+			}
+		}
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static uint32_t __timer_set_listener(timer_handle_t *timer, uint32_t tcnt, task_handle_t *listener, void (*notify_f)(void))
+ *
+ * @brief	Used by the system to set the timer listener and to convert the time to count into the system clock ticks
+ *
+ * @param 	timer   	the timer to run.
+ * @param 	tcnt		The time value to count in ms, max value is 2 162 687 832 [ms].
  * @param 	listener	If non-null, the listener task to run.
  * @param 	notify_f	If non-null, the notify function to call.
- * @param 	tcnt		The time value to count in ms, max value is 2 162 687 832 [ms].
+ *
+ * @returns	uint32_t	the time to count in ticks.
  **************************************************************************************************/
 
-void __timer_start_timer(timer_handle_t *timer, uint32_t tcnt, task_handle_t *listener, void (*notify_f)(void))
+static uint32_t __timer_set_listener(timer_handle_t *timer, uint32_t tcnt, task_handle_t *listener, void (*notify_f)(void))
 {
-	if( (tcnt == 0x00000000) || (timer == NULL) ) return;
-	
-	timer_handle_t *timer1  = (timer_handle_t *)__timer_timers;
-	uint32_t c_time = 0;
 	uint8_t irq_flag;
 		
 	irq_flag = rtos_cli();
@@ -161,13 +285,7 @@ void __timer_start_timer(timer_handle_t *timer, uint32_t tcnt, task_handle_t *li
 	}else{
 		timer->timer_notify_f = NULL;
 	}
-	while( (timer1 != timer) && (timer1 != NULL) ){
-		timer1 = timer1->next_timer;
-	}
-	if(timer1 == NULL){
-		timer->next_timer = (timer_handle_t *)__timer_timers;
-		__timer_timers	  = timer;
-	}
+	timer->period = 0;
 	/**
 	* We set the time [ms] for the countdown. 
 	* We add the current system time to the tcnt and apply the error correction by subtracting 7.08 microseconds from each millisecond.
@@ -175,10 +293,379 @@ void __timer_start_timer(timer_handle_t *timer, uint32_t tcnt, task_handle_t *li
 	if(!(tcnt & 0x80000000))tcnt += current_time;	//The TCNT timer register uses only 31 bits, so adding the current time no longer makes sense for much larger values. 
 	
 	if(tcnt >= 2162687832){ // if time is bigger than 2 162 687 832 [ms]
-		c_time = 0x7FFFFFFF;	 //fixed time
-			
+		return 0x7FFFFFFF;	 //fixed time
+	}
+	return __timer_ms_to_ticks_32bits(tcnt);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void __timer_start_periodic_timer(timer_handle_t *timer, uint32_t period, task_handle_t *listener, void (*notify_f)(void))
+ *
+ * @brief	Used by the system to start the auto-reload timer. The period is converted to ticks only once
+ *			and the timer is reloaded from its expiry time, so the time spent by the listener does not add drift
+ *
+ * @param 	timer   	If non-null, the timer to run.
+ * @param 	period		The period in ms, max value is 2 162 687 832 [ms].
+ * @param 	listener	If non-null, the listener task to run.
+ * @param 	notify_f	If non-null, the notify function to call.
+ **************************************************************************************************/
+
+void __timer_start_periodic_timer(timer_handle_t *timer, uint32_t period, task_handle_t *listener, void (*notify_f)(void))
+{
+	if( (period == 0x00000000) || (timer == NULL) ) return;
+	
+	__timer_start_timer(timer, period, listener, notify_f);
+	
+	if(period >= 2162687832){
+		timer->period = 0x7FFFFFFF;
+		
 	}else{
-		c_time = __timer_ms_to_ticks_32bits(tcnt);
+		timer->period = __timer_ms_to_ticks_32bits(period);
+		if(timer->period == 0)timer->period = 1;
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void timer_init(timer_handle_t *timer)
+ *
+ * @brief	use to clear the timer before its first start, the timer must not be counting down.
+ *
+ * @param 	timer   	If non-null, the timer to clear.
+ **************************************************************************************************/
+
+void timer_init(timer_handle_t *timer)
+{
+	if(timer == NULL) return;
+	
+	memset(timer, 0x00, sizeof(timer_handle_t));
+}
+
+
+#if BOARD_timers_timing_wheel == TRUE
+
+/**
+* Timing wheel: TIMER_wheel_levels levels of TIMER_wheel_slots slots, level 0 has the resolution of one tick,
+* every next level is TIMER_wheel_slots times coarser. The TCNT of a running timer keeps the absolute expiry tick
+* and the timer is linked to the slot given by the expiry tick and the time left. The timers of a higher level
+* slot are moved (cascaded) to lower levels when the wheel of the lower level completes its turn.
+*/
+#define TIMER_wheel_bits		4
+#define TIMER_wheel_slots		(1 << TIMER_wheel_bits)
+#define TIMER_wheel_levels		8
+#define TIMER_wheel_mask		0x7FFFFFFF
+
+static			timer_handle_t	*__timer_wheel[TIMER_wheel_levels][TIMER_wheel_slots];
+static			uint16_t		__timer_wheel_map[TIMER_wheel_levels];		//bit n is set if slot n is not empty
+static			uint32_t		__timer_wheel_time;							//the last processed tick
+static			uint8_t			__timer_wheel_count;						//number of running timers
+
+
+/**********************************************************************************************//**
+ * @fn	static void __timer_wheel_insert(timer_handle_t *timer, uint32_t base)
+ *
+ * @brief	Used by the system to link the timer to the wheel slot, the timer TCNT must keep the expiry tick
+ *
+ * @param 	timer	the timer to link.
+ * @param 	base	the next tick to process.
+ **************************************************************************************************/
+
+static void __timer_wheel_insert(timer_handle_t *timer, uint32_t base)
+{
+	uint32_t expires	= timer->TCNT;
+	uint32_t delta		= (expires - base) & TIMER_wheel_mask;
+	uint8_t level		= 0;
+	
+	while(delta >= TIMER_wheel_slots){
+		delta	>>= TIMER_wheel_bits;
+		expires	>>= TIMER_wheel_bits;
+		level++;
+	}
+	timer_handle_t **slot = &__timer_wheel[level][expires & (TIMER_wheel_slots - 1)];
+	
+	timer->next_timer	= *slot;
+	timer->pprev_timer	= slot;
+	if(*slot != NULL){
+		(*slot)->pprev_timer = &timer->next_timer;
+	}
+	*slot = timer;
+	__timer_wheel_map[level] |= _BV(expires & (TIMER_wheel_slots - 1));
+	__timer_wheel_count++;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __timer_wheel_remove(timer_handle_t *timer)
+ *
+ * @brief	Used by the system to unlink the timer from the wheel, after that the timer is not counting down
+ *
+ * @param 	timer	the running timer to unlink.
+ **************************************************************************************************/
+
+static void __timer_wheel_remove(timer_handle_t *timer)
+{
+	timer_handle_t **slot = timer->pprev_timer;
+	
+	*slot = timer->next_timer;
+	if(timer->next_timer != NULL){
+		(timer->next_timer)->pprev_timer = slot;
+		
+	}else if( (slot >= &__timer_wheel[0][0]) && (slot < &__timer_wheel[TIMER_wheel_levels][0]) && (*slot == NULL) ){	//the slot is empty now
+		uint8_t slot_nr = slot - &__timer_wheel[0][0];
+		
+		__timer_wheel_map[slot_nr >> TIMER_wheel_bits] &= ~_BV(slot_nr & (TIMER_wheel_slots - 1));
+	}
+	timer->next_timer	= NULL;
+	timer->pprev_timer	= NULL;
+	timer->TCNT			= 0x00000000;
+	__timer_wheel_count--;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	static void __timer_wheel_tick(void)
+ *
+ * @brief	Used by the system to process the next tick, the timers of higher levels are cascaded
+ *			when the lower level wheel completes its turn, the timers which expire in this tick are notified
+ *
+ **************************************************************************************************/
+
+static void __timer_wheel_tick(void)
+{
+	uint32_t time	= __timer_wheel_time = (__timer_wheel_time + 1) & TIMER_wheel_mask;
+	uint8_t idx		= time & (TIMER_wheel_slots - 1);
+	
+	if(idx == 0){
+		for(uint8_t level = 1; level < TIMER_wheel_levels; level++){
+			uint8_t level_idx = (time >> (level * TIMER_wheel_bits)) & (TIMER_wheel_slots - 1);
+			
+			if(__timer_wheel_map[level] & _BV(level_idx)){
+				timer_handle_t *timer = __timer_wheel[level][level_idx];
+				
+				__timer_wheel[level][level_idx]	= NULL;
+				__timer_wheel_map[level]		&= ~_BV(level_idx);
+				
+				while(timer != NULL){
+					timer_handle_t *next_timer = timer->next_timer;
+					
+					__timer_wheel_count--;
+					__timer_wheel_insert(timer, time);
+					timer = next_timer;
+				}
+			}
+			if(level_idx != 0)break;
+		}
+	}
+	if(__timer_wheel_map[0] & _BV(idx)){
+		timer_handle_t *expired = __timer_wheel[0][idx];	//the expired timers are moved to the local list, so the slot can be used by restarted timers
+		
+		__timer_wheel[0][idx]	= NULL;
+		__timer_wheel_map[0]	&= ~_BV(idx);
+		expired->pprev_timer	= &expired;
+		
+		while(expired != NULL){
+			timer_handle_t *timer = expired;
+			
+			__timer_wheel_remove(timer);
+			if(timer->period){		//the periodic timer is reloaded from its expiry tick
+				timer->TCNT = (time + timer->period) & TIMER_wheel_mask;
+				__timer_wheel_insert(timer, time + 1);
+			}
+			__timer_notify(timer);
+			
+			if(timer->pprev_timer == NULL){		//need to be checked because timer_notify_f() can restart timer
+				timer->timer_owner = NULL;
+			}
+		}
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void __timer_start_timer(timer_handle_t *timer, uint32_t tcnt, task_handle_t *listener, void (*notify_f)(void))
+ *
+ * @brief	Used by the system to start the timer. After the time has elapsed the timer can wake up the task or trigger a given function 
+ *
+ * @param 	timer   	If non-null, the timer to run.
+ * @param 	listener	If non-null, the listener task to run.
+ * @param 	notify_f	If non-null, the notify function to call.
+ * @param 	tcnt		The time value to count in ms, max value is 2 162 687 832 [ms].
+ **************************************************************************************************/
+
+void __timer_start_timer(timer_handle_t *timer, uint32_t tcnt, task_handle_t *listener, void (*notify_f)(void))
+{
+	if( (tcnt == 0x00000000) || (timer == NULL) ) return;
+	
+	uint32_t c_time = __timer_set_listener(timer, tcnt, listener, notify_f);
+	
+	if(c_time == 0)c_time = 1;
+	if(timer->pprev_timer != NULL){
+		__timer_wheel_remove(timer);
+	}
+	timer->TCNT = (__timer_wheel_time + c_time) & TIMER_wheel_mask;
+	__timer_wheel_insert(timer, __timer_wheel_time + 1);
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void __timer_stop_timer(timer_handle_t *timer, uint8_t if_notify_listener)
+ *
+ * @brief	Used by the system to stop the timer.
+ *
+ * @param 	timer			  	If non-null, the timer to stop.
+ * @param 	if_notify_listener	if TRUE the task owning this timer will be woken up or notification function will be triggered.
+ **************************************************************************************************/
+
+void __timer_stop_timer(timer_handle_t *timer, uint8_t if_notify_listener)
+{
+	if( (timer == NULL) || (timer->pprev_timer == NULL) )return;
+	
+	__timer_wheel_remove(timer);
+	
+	if(if_notify_listener == TRUE){
+		__timer_notify(timer);
+	}
+	if(timer->pprev_timer == NULL){		//need to be checked because timer_notify_f() can restart timer
+		timer->timer_owner = NULL;
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void __timer_stop_all_for_given_task(task_handle_t *owner)
+ *
+ * @brief	Used by the system to stop all timers for a specific task
+ *
+ * @param 	owner	If non-null, the owner task.
+ **************************************************************************************************/
+
+void __timer_stop_all_for_given_task(task_handle_t *owner)
+{
+	for(uint8_t level = 0; level < TIMER_wheel_levels; level++){
+		for(uint8_t idx = 0; (idx < TIMER_wheel_slots) && (__timer_wheel_map[level] >> idx); idx++){
+			timer_handle_t *timer = __timer_wheel[level][idx];
+			
+			while(timer != NULL){
+				timer_handle_t *next_timer = timer->next_timer;
+				
+				if( (timer->n == __TIMER_WITH_LISTENER) && (timer->timer_owner == owner) ){
+					timer_stop(timer);
+				}
+				timer = next_timer;
+			}
+		}
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	void __timer_refresh_timers(uint16_t time)
+ *
+ * @brief	Used by the system to refresh the time in all timers,
+ *			the ticks without any expiring timer and without cascading are skipped
+ *
+ * @param	time	number of ticks which have elapsed.
+ **************************************************************************************************/
+
+void __timer_refresh_timers(uint16_t time)
+{
+	while(time){
+		uint8_t idx = (__timer_wheel_time + 1) & (TIMER_wheel_slots - 1);
+		uint8_t skip = 0;
+		
+		if(__timer_wheel_count == 0){
+			__timer_wheel_time = (__timer_wheel_time + time) & TIMER_wheel_mask;
+			return;
+		}
+		if(idx != 0){		//skip the empty slots up to the next expiring timer or the end of the level 0 wheel turn
+			uint16_t pending = __timer_wheel_map[0] >> idx;
+			
+			while( (idx + skip < TIMER_wheel_slots) && !(pending & 0x0001) ){
+				pending >>= 1;
+				skip++;
+			}
+		}
+		if(skip){
+			if(skip > time)skip = time;
+			__timer_wheel_time = (__timer_wheel_time + skip) & TIMER_wheel_mask;
+			time -= skip;
+		
+		}else{
+			__timer_wheel_tick();
+			time--;
+		}
+	}
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint32_t __timer_get_nearest_expiry(void)
+ *
+ * @brief	Used by the system to find the time to the nearest timer expiry
+ *
+ * @returns	uint32_t	the lowest counter value or 0x7FFFFFFF if no timer is counting down.
+ **************************************************************************************************/
+
+uint32_t __timer_get_nearest_expiry(void)
+{
+	uint32_t nearest = 0x7FFFFFFF;
+	
+	for(uint8_t level = 0; level < TIMER_wheel_levels; level++){
+		for(uint8_t idx = 0; (idx < TIMER_wheel_slots) && (__timer_wheel_map[level] >> idx); idx++){
+			for(timer_handle_t *timer = __timer_wheel[level][idx]; timer != NULL; timer = timer->next_timer){
+				uint32_t time = timer_get_time(timer);
+				
+				if(time < nearest){
+					nearest = time;
+				}
+			}
+		}
+	}
+	return nearest;
+}
+
+
+/**********************************************************************************************//**
+ * @fn	uint32_t timer_get_time(timer_handle_t *timer)
+ *
+ * @brief	use to get the remaining time
+ *
+ * @param 		timer			  	If non-null, the timer to read.
+ * @returns		An uint32_t.
+ **************************************************************************************************/
+
+uint32_t timer_get_time(timer_handle_t *timer)
+{
+	return ( (timer != NULL) && (timer->pprev_timer != NULL) ) ? ((timer->TCNT - __timer_wheel_time) & TIMER_wheel_mask) : 0;	
+}
+
+#else
+
+/**********************************************************************************************//**
+ * @fn	void __timer_start_timer(timer_handle_t *timer, uint32_t tcnt, task_handle_t *listener, void (*notify_f)(void))
+ *
+ * @brief	Used by the system to start the timer. After the time has elapsed the timer can wake up the task or trigger a given function 
+ *
+ * @param 	timer   	If non-null, the timer to run.
+ * @param 	listener	If non-null, the listener task to run.
+ * @param 	notify_f	If non-null, the notify function to call.
+ * @param 	tcnt		The time value to count in ms, max value is 2 162 687 832 [ms].
+ **************************************************************************************************/
+
+void __timer_start_timer(timer_handle_t *timer, uint32_t tcnt, task_handle_t *listener, void (*notify_f)(void))
+{
+	if( (tcnt == 0x00000000) || (timer == NULL) ) return;
+	
+	timer_handle_t *timer1  = (timer_handle_t *)__timer_timers;
+	uint32_t c_time = __timer_set_listener(timer, tcnt, listener, notify_f);
+
+	while( (timer1 != timer) && (timer1 != NULL) ){
+		timer1 = timer1->next_timer;
+	}
+	if(timer1 == NULL){
+		timer->next_timer = (timer_handle_t *)__timer_timers;
+		__timer_timers	  = timer;
 	}
 	timer->TCNT = c_time;
 }
@@ -205,20 +692,8 @@ void __timer_stop_timer(timer_handle_t *timer, uint8_t if_notify_listener)
 	if(*timer_l != NULL){
 		timer->TCNT = 0x00000000;
 
-		if( (timer->timer_owner != NULL) && (if_notify_listener == TRUE) ){
-			if(timer->n == __TIMER_WITH_NOTIFY){
-				timer->timer_notify_f();
-				
-			}else{
-				task_state_t task_state = task_get_state(timer->timer_owner);
-				
-				if( (task_state == STOPPED) ||
-					(task_state == SLEEP_INFINITE) ||
-					(task_state == SLEEP_TIMED) )
-				{
-					task_unfreeze(timer->timer_owner);
-				}
-			}
+		if(if_notify_listener == TRUE){
+			__timer_notify(timer);
 		}
 		if(timer->TCNT == 0){		//need to be checked because timer_notify_f() can restart timer and TCNT will be non zero
 			timer->timer_owner	= NULL;
@@ -252,6 +727,29 @@ void __timer_stop_all_for_given_task(task_handle_t *owner)
 }
 
 
+/**********************************************************************************************//**
+ * @fn	static uint32_t __timer_get_reload_time(timer_handle_t *timer, uint16_t overshoot)
+ *
+ * @brief	Used by the system to get the next countdown of the expired timer. The periodic timer is
+ *			reloaded from its expiry time, the periods which have been missed completely are skipped
+ *
+ * @param 	timer		the expired timer.
+ * @param 	overshoot	number of ticks which have elapsed since the expiry.
+ *
+ * @returns	uint32_t	the ticks to the next expiry or 0 for the one-shot timer.
+ **************************************************************************************************/
+
+static uint32_t __timer_get_reload_time(timer_handle_t *timer, uint16_t overshoot)
+{
+	if(timer->period == 0)return 0x00000000;
+	
+	if(overshoot >= timer->period){
+		overshoot %= timer->period;
+	}
+	return timer->period - overshoot;
+}
+
+
 /**********************************************************************************************//**
  * @fn	void __timer_refresh_timers(uint16_t time)
  *
@@ -273,28 +771,23 @@ void __timer_refresh_timers(uint16_t time)
 			(*timer)->TCNTL = (0xFFFF - time + (*timer)->TCNTL + 1);
 			
 		}else{
-			(*timer)->TCNT = 0x00000000;
-
-			if((*timer)->timer_owner != NULL){
-				if((*timer)->n == __TIMER_WITH_NOTIFY){
-					(*timer)->timer_notify_f();
-						
-				}else{
-					task_state_t task_state = task_get_state((*timer)->timer_owner);
-					
-					if( (task_state == STOPPED) ||
-						(task_state == SLEEP_INFINITE) ||
-						(task_state == SLEEP_TIMED) )
-					{
-						task_unfreeze((*timer)->timer_owner);
-					}
+			timer_handle_t *t_exp = *timer;
+			
+			t_exp->TCNT = __timer_get_reload_time(t_exp, time - t_exp->TCNTL);
+			__timer_notify(t_exp);
+			
+			if(*timer != t_exp){	//timer_notify_f() has changed the list
+				if(t_exp->timer_owner == NULL){		//the timer has been stopped
+					continue;
+				}
+				while(*timer != t_exp){		//skip the timers started by timer_notify_f(), the time has elapsed before they were started
+					timer = &((*timer)->next_timer);
 				}
 			}
-			if((*timer)->TCNT == 0x00000000){  //need to be checked because timer_notify_f() can restart timer and TCNT will be non zero
-				timer_handle_t *t_off = *timer;
-				(*timer)->timer_owner	= NULL;
-				*timer				= (*timer)->next_timer;
-				t_off->next_timer	= NULL;
+			if(t_exp->TCNT == 0x00000000){  //need to be checked because timer_notify_f() can restart timer and TCNT will be non zero
+				t_exp->timer_owner	= NULL;
+				*timer				= t_exp->next_timer;
+				t_exp->next_timer	= NULL;
 				continue;	
 			}
 		}
@@ -303,6 +796,27 @@ void __timer_refresh_timers(uint16_t time)
 }
 
 
+/**********************************************************************************************//**
+ * @fn	uint32_t __timer_get_nearest_expiry(void)
+ *
+ * @brief	Used by the system to find the time to the nearest timer expiry
+ *
+ * @returns	uint32_t	the lowest counter value or 0x7FFFFFFF if no timer is counting down.
+ **************************************************************************************************/
+
+uint32_t __timer_get_nearest_expiry(void)
+{
+	uint32_t nearest = 0x7FFFFFFF;
+	
+	for(timer_handle_t *timer = (timer_handle_t *)__timer_timers; timer != NULL; timer = timer->next_timer){
+		if(timer->TCNT < nearest){
+			nearest = timer->TCNT;
+		}
+	}
+	return nearest;
+}
+
+
 /**********************************************************************************************//**
  * @fn	uint32_t timer_get_time(timer_handle_t *timer)
  *
@@ -317,6 +831,8 @@ uint32_t timer_get_time(timer_handle_t *timer)
 	return (timer != NULL) ? timer->TCNT : 0;	
 }
 
+#endif
+
 
 /**********************************************************************************************//**
  * @fn	int8_t timer_cmp_timers_time(timer_handle_t *tim1, timer_handle_t *tim2)
@@ -333,12 +849,11 @@ uint32_t timer_get_time(timer_handle_t *timer)
 int8_t timer_cmp_timers_time(timer_handle_t *tim1, timer_handle_t *tim2)
 {
 	if( (tim1 == NULL) || (tim2 == NULL) ||
-		(tim1->TCNT == tim2->TCNT)
+		(timer_get_time(tim1) == timer_get_time(tim2))
 	)return 0;
 	
-	if(tim1->TCNT < tim2->TCNT) return -0x01;
+	if(timer_get_time(tim1) < timer_get_time(tim2)) return -0x01;
 
 	return 0x01;
 }
 #endif
-
@@ -13,6 +13,8 @@ uint16_t __timer_get_time_ms(void);
 void	 __timer_clear_time_ms(void);
 uint16_t __timer_ms_to_ticks_16bits(uint16_t time_ms);
 uint32_t __timer_ms_to_ticks_32bits(uint32_t time_ms);
+uint8_t	 __timer_tickless_enter(uint32_t deadline);
+void	 __timer_tickless_exit(void);
 
 
 
@@ -38,6 +40,10 @@ typedef struct timer{
 		void				(*timer_notify_f)(void);
 	};
 	struct timer 			*next_timer;
+	uint32_t				period;				//reload value in ticks for the periodic timer, 0 for the one-shot timer
+#if BOARD_timers_timing_wheel == TRUE
+	struct timer 			**pprev_timer;		//the link pointing to this timer, NULL if the timer is not counting down
+#endif
 
 }timer_handle_t;
 
@@ -46,18 +52,32 @@ typedef struct timer{
 
 
 #if BOARD_include_timers == TRUE
+uint32_t __timer_get_nearest_expiry(void);
 void __timer_stop_all_for_given_task(task_handle_t *owner);
 void __timer_refresh_timers(uint16_t time);
 void __timer_start_timer(timer_handle_t *timer, uint32_t tcnt, task_handle_t *listener, void (*notify_f)(void));
+void __timer_start_periodic_timer(timer_handle_t *timer, uint32_t period, task_handle_t *listener, void (*notify_f)(void));
 void __timer_stop_timer(timer_handle_t *timer, uint8_t if_notify_listener);
 
 
+/**********************************************************************************************//**
+ * @fn	void timer_init(timer_handle_t *timer)
+ *
+ * @brief	use to clear the timer before its first start, the timer must not be counting down.
+ *			The timing wheel (BOARD_timers_timing_wheel) trusts the links of the timer, so a timer which is not
+ *			a global or static variable has to be cleared before it is started.
+ *
+ * @param 	timer   	If non-null, the timer to clear.
+ **************************************************************************************************/
+void timer_init(timer_handle_t *timer);
+
+
 
 /**********************************************************************************************//**
  * @fn	void timer_start_notify_task(timer_handle_t *timer, uint32_t tcnt, task_handle_t *listener)
  *
  * @brief	If you want to notify some listener/task when the countdown is finished, use this function to start the timer 
- *			max time 2 162 796 244[ms]
+ *			max time 2 162 687 832[ms]
  *
  * @param 	timer   	If non-null, the timer to run.
  * @param 	listener	If non-null, the listener task to run.
@@ -72,7 +92,7 @@ void __timer_stop_timer(timer_handle_t *timer, uint8_t if_notify_listener);
  * @fn	void timer_start_notify_function(timer_handle_t *timer, uint32_t tcnt, void (*notify_f)(void))
  *
  * @brief	If you want to call some function when the countdown is finished, use this function to start the timer 
- *			max time 2 162 796 244[ms]
+ *			max time 2 162 687 832[ms]
  *
  * @param 	timer   	If non-null, the timer to run.
  * @param 	notify_f	If non-null, the notify function to call.
@@ -86,7 +106,7 @@ void __timer_stop_timer(timer_handle_t *timer, uint8_t if_notify_listener);
  * @fn	void timer_start(timer_handle_t *timer, uint32_t tcnt)
  *
  * @brief	If you want to start the timer without sending a notification when the countdown ends, use this function to start the timer
- *			max time 2 162 796 244[ms] 
+ *			max time 2 162 687 832[ms] 
  *
  * @param 	timer   	If non-null, the timer to run.
  * @param 	tcnt		The time value to count in ms.
@@ -95,6 +115,37 @@ void __timer_stop_timer(timer_handle_t *timer, uint8_t if_notify_listener);
 	__timer_start_timer(timer, tcnt, NULL, NULL)
 
 
+/**********************************************************************************************//**
+ * @fn	void timer_start_periodic_notify_task(timer_handle_t *timer, uint32_t period, task_handle_t *listener)
+ *
+ * @brief	If you want to notify some listener/task periodically, use this function to start the auto-reload timer.
+ *			The timer is reloaded from the previous expiry time, so the period does not drift
+ *			max period 2 162 687 832[ms]
+ *
+ * @param 	timer   	If non-null, the timer to run.
+ * @param 	period		The period in ms.
+ * @param 	listener	If non-null, the listener task to run, the default is the current task.
+ **************************************************************************************************/
+#define timer_start_periodic_notify_task(...)	VRG(timer_start_periodic_notify_task, __VA_ARGS__)
+#define timer_start_periodic_notify_task2(timer, period)			__timer_start_periodic_timer(timer, period, task_this(), NULL)
+#define timer_start_periodic_notify_task3(timer, period, listener)	__timer_start_periodic_timer(timer, period, listener, NULL)
+
+
+/**********************************************************************************************//**
+ * @fn	void timer_start_periodic_notify_function(timer_handle_t *timer, uint32_t period, void (*notify_f)(void))
+ *
+ * @brief	If you want to call some function periodically, use this function to start the auto-reload timer.
+ *			The timer is reloaded from the previous expiry time, so the period does not drift
+ *			max period 2 162 687 832[ms]
+ *
+ * @param 	timer   	If non-null, the timer to run.
+ * @param 	period		The period in ms.
+ * @param 	notify_f	If non-null, the notify function to call.
+ **************************************************************************************************/
+#define timer_start_periodic_notify_function(timer, period, notify)\
+	__timer_start_periodic_timer(timer, period, NULL, notify)
+
+
 /**********************************************************************************************//**
  * @fn	uint32_t timer_get_time(timer_handle_t *timer)
  *